@@ -0,0 +1,42 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+
+// Helpers shared by the Benchmark* functions that main.cpp runs with RUN_BENCHMARKS
+
+
+// milliseconds from start to end
+inline double BenchmarkMs(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+// Linear congruential generator for benchmark data. Not good randomness, but the same sequence on every run and platform,
+// so timings stay comparable
+class BenchmarkRandom
+{
+public:
+    BenchmarkRandom(unsigned int seed) : seed(seed)
+    {
+    }
+
+    // 24 random bits
+    unsigned int Next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+    // in [0, 1)
+    float NextFloat()
+    {
+        return (float)Next() / 16777216.0f;
+    }
+
+private:
+    unsigned int seed;
+};
+
+#endif
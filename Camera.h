@@ -19,9 +19,24 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.5f;
 const float ZOOM = 90.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 
-// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+// Indices into the plane array returned by Camera::GetFrustumPlanes
+enum Frustum_Plane {
+    FRUSTUM_LEFT,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR
+};
+
+
+// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL.
+// The matrices and frustum planes are cached and only rebuilt after something they depend on changed, so they can be queried any
+// number of times per frame. Code that writes Position, Yaw, Pitch or Zoom directly has to call Invalidate() afterwards.
 class Camera
 {
 public:
@@ -38,9 +53,13 @@ public:
     float MovementSpeed;
     float MouseSensitivity;
     float Zoom;
+    // projection options
+    float AspectRatio;
+    float NearPlane;
+    float FarPlane;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), AspectRatio(1.0f), NearPlane(NEAR_PLANE), FarPlane(FAR_PLANE)
     {
         Position = position;
         WorldUp = up;
@@ -49,7 +68,7 @@ public:
         updateCameraVectors();
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), AspectRatio(1.0f), NearPlane(NEAR_PLANE), FarPlane(FAR_PLANE)
     {
         Position = glm::vec3(posX, posY, posZ);
         WorldUp = glm::vec3(upX, upY, upZ);
@@ -59,9 +78,92 @@ public:
     }
 
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4& GetViewMatrix() const
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        updateMatrices();
+        return view;
+    }
+
+    // returns the perspective projection built from Zoom (vertical field of view), AspectRatio and the clip planes
+    const glm::mat4& GetProjectionMatrix() const
+    {
+        updateMatrices();
+        return projection;
+    }
+
+    // returns projection * view
+    const glm::mat4& GetViewProjectionMatrix() const
+    {
+        updateMatrices();
+        return viewProjection;
+    }
+
+    const glm::mat4& GetInverseViewMatrix() const
+    {
+        updateMatrices();
+        return inverseView;
+    }
+
+    const glm::mat4& GetInverseProjectionMatrix() const
+    {
+        updateMatrices();
+        return inverseProjection;
+    }
+
+    const glm::mat4& GetInverseViewProjectionMatrix() const
+    {
+        updateMatrices();
+        return inverseViewProjection;
+    }
+
+    // returns the six world space frustum planes (indexed by Frustum_Plane) as (normal, distance) with normals pointing inwards,
+    // so a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane
+    const glm::vec4* GetFrustumPlanes() const
+    {
+        updateMatrices();
+        return frustumPlanes;
+    }
+
+    // returns true if the axis aligned box is at least partly inside the frustum (conservative, may accept boxes near corners)
+    bool IsBoxInFrustum(glm::vec3 boxMin, glm::vec3 boxMax) const
+    {
+        updateMatrices();
+        for (int i = 0; i < 6; i++) {
+            const glm::vec4& plane = frustumPlanes[i];
+            // the box corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x, plane.y >= 0.0f ? boxMax.y : boxMin.y, plane.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    void SetAspectRatio(float aspectRatio)
+    {
+        if (aspectRatio != AspectRatio) {
+            AspectRatio = aspectRatio;
+            projectionDirty = true;
+        }
+    }
+
+    void SetClipPlanes(float nearPlane, float farPlane)
+    {
+        NearPlane = nearPlane;
+        FarPlane = farPlane;
+        projectionDirty = true;
+    }
+
+    void SetPosition(glm::vec3 position)
+    {
+        Position = position;
+        viewDirty = true;
+    }
+
+    // marks every cached matrix as stale, needed after writing the public attributes directly
+    void Invalidate()
+    {
+        updateCameraVectors();
+        projectionDirty = true;
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -76,6 +178,7 @@ public:
             Position -= Right * velocity;
         if (direction == RIGHT)
             Position += Right * velocity;
+        viewDirty = true;
     }
 
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
@@ -108,9 +211,55 @@ public:
             Zoom = 1.0f;
         if (Zoom > 90.0f)
             Zoom = 90.0f;
+        projectionDirty = true;
     }
 
 private:
+    // cached matrices, rebuilt lazily by updateMatrices
+    mutable glm::mat4 view;
+    mutable glm::mat4 projection;
+    mutable glm::mat4 viewProjection;
+    mutable glm::mat4 inverseView;
+    mutable glm::mat4 inverseProjection;
+    mutable glm::mat4 inverseViewProjection;
+    mutable glm::vec4 frustumPlanes[6];
+    mutable bool viewDirty = true;
+    mutable bool projectionDirty = true;
+
+    // rebuilds whatever the dirty flags say is stale, plus everything derived from it
+    void updateMatrices() const
+    {
+        if (!viewDirty && !projectionDirty)
+            return;
+
+        if (viewDirty) {
+            view = glm::lookAt(Position, Position + Front, Up);
+            inverseView = glm::inverse(view);
+        }
+        if (projectionDirty) {
+            projection = glm::perspective(glm::radians(Zoom), AspectRatio, NearPlane, FarPlane);
+            inverseProjection = glm::inverse(projection);
+        }
+        viewProjection = projection * view;
+        inverseViewProjection = inverseView * inverseProjection;
+
+        // Gribb/Hartmann: each plane is the last row of viewProjection plus or minus one of the other rows
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        frustumPlanes[FRUSTUM_LEFT] = rows[3] + rows[0];
+        frustumPlanes[FRUSTUM_RIGHT] = rows[3] - rows[0];
+        frustumPlanes[FRUSTUM_BOTTOM] = rows[3] + rows[1];
+        frustumPlanes[FRUSTUM_TOP] = rows[3] - rows[1];
+        frustumPlanes[FRUSTUM_NEAR] = rows[3] + rows[2];
+        frustumPlanes[FRUSTUM_FAR] = rows[3] - rows[2];
+        for (int i = 0; i < 6; i++)
+            frustumPlanes[i] /= glm::length(glm::vec3(frustumPlanes[i]));
+
+        viewDirty = false;
+        projectionDirty = false;
+    }
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
@@ -123,6 +272,7 @@ private:
         // also re-calculate the Right and Up vector
         Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
         Up = glm::normalize(glm::cross(Right, Front));
+        viewDirty = true;
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,361 @@
+#ifndef CHUNK_MANAGER_H
+#define CHUNK_MANAGER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Camera.h"
+#include "ChunkMesher.h"
+#include "JobSystem.h"
+#include "MeshingPipeline.h"
+#include "MpscQueue.h"
+#include "TerrainGenerator.h"
+#include "VoxelChunk.h"
+#include "VoxelRenderer.h"
+
+// Default chunk streaming values
+const int CHUNK_LOAD_RADIUS = 6;                    // chunks around the camera's chunk (horizontally) that get loaded
+const int CHUNK_UNLOAD_RADIUS = 8;                  // loaded chunks stay until they are this far, so walking along a border doesn't thrash
+const int CHUNK_WORLD_LAYERS = 2;                   // chunk layers from y = 0 up, the world isn't streamed vertically
+const unsigned int CHUNK_MAX_GENERATING = 16;       // generation jobs in flight, few enough that re-prioritizing still matters
+const size_t CHUNK_UPLOAD_BUDGET_BYTES = 1 << 20;   // mesh bytes uploaded per Update
+const double CHUNK_UPLOAD_BUDGET_MS = 1.0;          // upload time per Update
+
+
+// Streams the world around the camera: chunks within CHUNK_LOAD_RADIUS of the camera's chunk are queued, generated as one
+// JobSystem job per chunk (at most CHUNK_MAX_GENERATING at once), meshed through a MeshingPipeline and uploaded to a
+// VoxelRenderer within a byte and time budget, and unloaded again once further than CHUNK_UNLOAD_RADIUS.
+// The load queue is re-prioritized every Update, nearest first with chunks in front of the camera pulled ahead of the ones
+// behind it. A chunk is only meshed once its neighbors that are going to load have, so the borders are meshed once, right.
+class ChunkManager
+{
+public:
+    // fills a new chunk, by default with a TerrainGenerator. Runs on the workers, several chunks at once, so it must only read
+    // shared state; each job keeps the Generator it was submitted with
+    std::function<void(Chunk&)> Generator;
+
+    // cumulative statistics
+    unsigned int ChunksGenerated = 0;
+    unsigned int GenerationsDiscarded = 0;  // chunks that finished generating after they left the load radius
+    unsigned int ChunksUnloaded = 0;
+
+    // statistics of the last Update
+    unsigned int GeneratedLastUpdate = 0;
+    unsigned int UploadsLastUpdate = 0;
+    size_t BytesUploadedLastUpdate = 0;
+    double GenerateMs = 0.0;                // collecting and submitting generation jobs
+    double UploadMs = 0.0;
+
+    // time from a chunk being queued to its first mesh reaching the renderer, in seconds since the last ResetStats
+    double TotalTimeToVisible = 0.0;
+    double MaxTimeToVisible = 0.0;
+    unsigned int ChunksMadeVisible = 0;
+
+    ChunkManager(JobSystem& jobs, VoxelRenderer& renderer) : jobs(jobs), generated(CHUNK_MAX_GENERATING), meshing(jobs, renderer.Format()), renderer(renderer)
+    {
+        TerrainGenerator terrain(TERRAIN_DEFAULT_SEED);
+        Generator = [terrain](Chunk& chunk) {
+            terrain.Generate(chunk);
+        };
+    }
+
+    ~ChunkManager()
+    {
+        // the jobs still running write to the queue, so they have to be collected before it goes away
+        while (generating > 0) {
+            Chunk* chunk;
+            if (generated.TryPop(chunk)) {
+                delete chunk;
+                generating--;
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    ChunkManager(const ChunkManager&) = delete;
+    ChunkManager& operator=(const ChunkManager&) = delete;
+
+    // queue depths
+    unsigned int LoadQueueDepth() const { return (unsigned int)loadQueue.size(); }
+    unsigned int GeneratingDepth() const { return generating; }
+    unsigned int MeshingQueueDepth() const { return meshing.Pending(); }
+    unsigned int UploadQueueDepth() const { return (unsigned int)uploads.size(); }
+    unsigned int LoadedChunks() const { return loadedCount; }
+
+    const MeshingPipeline& Meshing() const { return meshing; }
+
+    // chunk containing a world position, with the renderer's world origin
+    glm::ivec3 ChunkAt(const glm::vec3& position) const
+    {
+        return glm::ivec3(glm::floor((position - renderer.WorldOrigin) / (float)CHUNK_SIZE));
+    }
+
+    // null unless loaded
+    Chunk* Find(const glm::ivec3& position)
+    {
+        auto it = slots.find(position);
+        return it != slots.end() ? it->second.chunk.get() : nullptr;
+    }
+
+    // remeshes every loaded chunk in the new format, the renderer drops what it has
+    void SetFormat(Voxel_Mesh_Format format)
+    {
+        if (format == renderer.Format())
+            return;
+        renderer.SetFormat(format);
+        meshing.SetFormat(format);
+        uploads.clear();
+        for (auto& entry : slots) {
+            if (entry.second.chunk) {
+                meshing.Cancel(entry.first);
+                entry.second.meshRequested = false;
+            }
+        }
+        for (auto& entry : slots)
+            tryMesh(entry.first);
+    }
+
+    // GL thread, once per frame. time is in seconds (glfwGetTime)
+    void Update(const Camera& camera, double time)
+    {
+        glm::ivec3 center = ChunkAt(camera.Position);
+        if (!hasCenter || center.x != lastCenter.x || center.z != lastCenter.z) {
+            refreshArea(center, time);
+            lastCenter = center;
+            hasCenter = true;
+        }
+        prioritize(camera);
+        generate();
+        upload(time);
+    }
+
+    void ResetStats()
+    {
+        TotalTimeToVisible = 0.0;
+        MaxTimeToVisible = 0.0;
+        ChunksMadeVisible = 0;
+    }
+
+private:
+    struct Slot {
+        std::unique_ptr<Chunk> chunk;   // null while queued or generating
+        double queuedAt = 0.0;
+        bool generating = false;        // a job is filling the chunk
+        bool meshRequested = false;
+        bool visible = false;           // a mesh was uploaded
+    };
+
+    JobSystem& jobs;
+    MpscQueue<Chunk*> generated;        // filled by the generation jobs, drained by generate
+    unsigned int generating = 0;        // jobs whose chunk hasn't been popped yet, never more than the queue holds
+    MeshingPipeline meshing;
+    VoxelRenderer& renderer;
+    std::unordered_map<glm::ivec3, Slot, ChunkPositionHash> slots;
+    std::vector<glm::ivec3> loadQueue;  // queued slots without a job, best first after prioritize
+    std::deque<MeshedChunk> uploads;    // meshes delivered by the pipeline, waiting for upload budget
+    unsigned int loadedCount = 0;
+    glm::ivec3 lastCenter = glm::ivec3(0);
+    bool hasCenter = false;
+
+    static int horizontalDistance2(const glm::ivec3& a, const glm::ivec3& b)
+    {
+        int dx = a.x - b.x, dz = a.z - b.z;
+        return dx * dx + dz * dz;
+    }
+
+    // queues what came into the load radius, unloads what left the unload radius and forgets queued chunks that left the load
+    // radius before they were generated (a job already running for one has its chunk thrown away when it comes back)
+    void refreshArea(const glm::ivec3& center, double time)
+    {
+        const int loadRadius2 = CHUNK_LOAD_RADIUS * CHUNK_LOAD_RADIUS, unloadRadius2 = CHUNK_UNLOAD_RADIUS * CHUNK_UNLOAD_RADIUS;
+        std::vector<glm::ivec3> dropped;    // queued or unloaded, either way their neighbors mesh without them now
+        for (auto it = slots.begin(); it != slots.end(); ) {
+            int distance2 = horizontalDistance2(it->first, center);
+            if (it->second.chunk ? distance2 <= unloadRadius2 : distance2 <= loadRadius2) {
+                ++it;
+                continue;
+            }
+            if (it->second.chunk) {
+                meshing.Cancel(it->first);
+                renderer.Remove(it->first);
+                loadedCount--;
+                ChunksUnloaded++;
+            }
+            dropped.push_back(it->first);
+            it = slots.erase(it);
+        }
+
+        for (int dz = -CHUNK_LOAD_RADIUS; dz <= CHUNK_LOAD_RADIUS; dz++)
+            for (int dx = -CHUNK_LOAD_RADIUS; dx <= CHUNK_LOAD_RADIUS; dx++) {
+                if (dx * dx + dz * dz > loadRadius2)
+                    continue;
+                for (int y = 0; y < CHUNK_WORLD_LAYERS; y++) {
+                    glm::ivec3 position(center.x + dx, y, center.z + dz);
+                    if (slots.count(position))
+                        continue;
+                    slots[position].queuedAt = time;
+                }
+            }
+
+        loadQueue.clear();
+        for (auto& entry : slots) {
+            if (!entry.second.chunk && !entry.second.generating)
+                loadQueue.push_back(entry.first);
+        }
+
+        // neighbors that were waiting for a dropped chunk go ahead without it, and the ones meshed against an unloaded chunk
+        // are meshed again so their faces toward it aren't left culled
+        for (const glm::ivec3& position : dropped)
+            for (int face = 0; face < 6; face++)
+                tryMesh(position + faceOffset(face));
+    }
+
+    // nearest first, a chunk straight behind the camera counts twice as far as one straight ahead
+    void prioritize(const Camera& camera)
+    {
+        if (loadQueue.empty())
+            return;
+        glm::vec2 eye = glm::vec2(camera.Position.x - renderer.WorldOrigin.x, camera.Position.z - renderer.WorldOrigin.z) / (float)CHUNK_SIZE;
+        glm::vec2 front(camera.Front.x, camera.Front.z);
+        float frontLength = glm::length(front);
+        front = frontLength > 0.0f ? front / frontLength : glm::vec2(0.0f);
+
+        std::vector<std::pair<float, glm::ivec3>> scored;
+        scored.reserve(loadQueue.size());
+        for (const glm::ivec3& position : loadQueue) {
+            glm::vec2 toChunk = glm::vec2(position.x + 0.5f, position.z + 0.5f) - eye;
+            float distance = glm::length(toChunk);
+            float facing = distance > 0.0f ? glm::dot(toChunk / distance, front) : 1.0f;
+            // lower layers break ties, they hold most of the surface
+            scored.emplace_back(distance * (1.5f - 0.5f * facing) + position.y * 0.01f, position);
+        }
+        std::sort(scored.begin(), scored.end(), [](const std::pair<float, glm::ivec3>& a, const std::pair<float, glm::ivec3>& b) {
+            return a.first < b.first;
+        });
+        for (size_t i = 0; i < scored.size(); i++)
+            loadQueue[i] = scored[i].second;
+    }
+
+    // takes in the chunks generated since the last Update, then keeps CHUNK_MAX_GENERATING jobs going from the front of the
+    // queue. Chunks only depend on their position, so a slot dropped and queued again while its old job was running can take
+    // that job's chunk as well as its own
+    void generate()
+    {
+        GeneratedLastUpdate = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        Chunk* chunk;
+        while (generated.TryPop(chunk)) {
+            generating--;
+            auto it = slots.find(chunk->Position);
+            if (it == slots.end() || !it->second.generating) {
+                delete chunk;
+                GenerationsDiscarded++;
+                continue;
+            }
+            it->second.generating = false;
+            it->second.chunk.reset(chunk);
+            loadedCount++;
+            ChunksGenerated++;
+            GeneratedLastUpdate++;
+
+            // the new chunk and the neighbors that may have been waiting for it
+            glm::ivec3 position = chunk->Position;
+            tryMesh(position);
+            for (int face = 0; face < 6; face++)
+                tryMesh(position + faceOffset(face));
+        }
+
+        size_t taken = 0;
+        for (; taken < loadQueue.size() && generating < CHUNK_MAX_GENERATING; taken++) {
+            glm::ivec3 position = loadQueue[taken];
+            slots[position].generating = true;
+            generating++;
+
+            MpscQueue<Chunk*>* queue = &generated;
+            std::function<void(Chunk&)> generator = Generator;
+            jobs.Submit([position, generator, queue]() {
+                Chunk* chunk = new Chunk(position);
+                generator(*chunk);
+                // can't fail, at most CHUNK_MAX_GENERATING chunks exist at once
+                queue->TryPush(chunk);
+            });
+        }
+        loadQueue.erase(loadQueue.begin(), loadQueue.begin() + taken);
+        GenerateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    static glm::ivec3 faceOffset(int face)
+    {
+        glm::ivec3 offset(0);
+        offset[face / 2] = face % 2 == 0 ? 1 : -1;
+        return offset;
+    }
+
+    // requests a loaded chunk's mesh unless a neighbor it is waiting for is still queued. A chunk that was meshed before is
+    // requested again, which the pipeline drops unless a neighbor arrived since
+    void tryMesh(const glm::ivec3& position)
+    {
+        auto it = slots.find(position);
+        if (it == slots.end() || !it->second.chunk)
+            return;
+        const Chunk* neighbors[6];
+        for (int face = 0; face < 6; face++) {
+            auto neighbor = slots.find(position + faceOffset(face));
+            if (neighbor == slots.end()) {
+                neighbors[face] = nullptr;
+                continue;
+            }
+            if (!neighbor->second.chunk && !it->second.meshRequested)
+                return;
+            neighbors[face] = neighbor->second.chunk.get();
+        }
+        meshing.Request(*it->second.chunk, neighbors);
+        it->second.meshRequested = true;
+    }
+
+    // collects finished meshes and uploads them until the byte or time budget is used up, at least one per Update
+    void upload(double time)
+    {
+        meshing.Poll([&](MeshedChunk& meshed) {
+            uploads.push_back(std::move(meshed));
+        });
+
+        UploadsLastUpdate = 0;
+        BytesUploadedLastUpdate = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (!uploads.empty()) {
+            if (UploadsLastUpdate > 0 && (BytesUploadedLastUpdate + uploads.front().Vertices.size() * sizeof(uint32_t) > CHUNK_UPLOAD_BUDGET_BYTES
+                || std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= CHUNK_UPLOAD_BUDGET_MS))
+                break;
+            MeshedChunk& meshed = uploads.front();
+            auto it = slots.find(meshed.Position);
+            // unloaded while waiting
+            if (it != slots.end() && it->second.chunk) {
+                renderer.Upload(meshed);
+                UploadsLastUpdate++;
+                BytesUploadedLastUpdate += meshed.Vertices.size() * sizeof(uint32_t);
+                if (!it->second.visible) {
+                    it->second.visible = true;
+                    double wait = time - it->second.queuedAt;
+                    TotalTimeToVisible += wait;
+                    MaxTimeToVisible = std::max(MaxTimeToVisible, wait);
+                    ChunksMadeVisible++;
+                }
+            }
+            uploads.pop_front();
+        }
+        UploadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+};
+
+#endif
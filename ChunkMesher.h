@@ -0,0 +1,608 @@
+#ifndef CHUNK_MESHER_H
+#define CHUNK_MESHER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "Benchmark.h"
+#include "VoxelChunk.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Default meshing values
+const int SNAPSHOT_SIZE = CHUNK_SIZE + 2;     // a chunk plus one block of its neighbors on every side
+
+
+// Faces of a block, in the order of the neighbor chunks handed to ChunkSnapshot::Capture
+enum Voxel_Face {
+    FACE_POS_X,
+    FACE_NEG_X,
+    FACE_POS_Y,
+    FACE_NEG_Y,
+    FACE_POS_Z,
+    FACE_NEG_Z
+};
+
+// everything but air hides the faces behind it
+inline bool IsOpaque(BlockId block) { return block != BLOCK_AIR; }
+
+// index of the lowest set bit, bits must not be 0
+inline int LowestSetBit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+inline int CountSetBits(uint32_t bits)
+{
+#if defined(_MSC_VER)
+    return (int)__popcnt(bits);
+#else
+    return __builtin_popcount(bits);
+#endif
+}
+
+
+// One rectangle of same-block faces on a chunk's surface, 10 bytes.
+// (x, y, z) is the block at the rectangle's minimum corner; it spans width blocks along the face's first tangent axis and
+// height along the second, with the tangents of a face along axis d being (d + 1) % 3 and (d + 2) % 3.
+// ao holds the ambient occlusion level (0 darkest, 3 open) of the four corners, 2 bits each, in the order minimum corner,
+// +first tangent, +both, +second tangent. Faces only merge when all four match, so the levels hold for the whole rectangle
+struct VoxelQuad {
+    uint8_t x, y, z;
+    uint8_t face;
+    uint8_t width, height;
+    uint8_t ao;
+    BlockId block;
+
+    int CornerOcclusion(int corner) const { return (ao >> (corner * 2)) & 3; }
+};
+
+
+// A chunk mesh vertex packed in one uint32 (voxel.vs unpacks it), a fifth of the five float vertices of the cubes:
+//  bits  0-17  chunk local x, y, z, 6 bits each (0..32, corners lie on block boundaries)
+//  bits 18-20  face (Voxel_Face), which gives the normal and the texture axes
+//  bits 21-22  ambient occlusion level
+//  bits 23-31  texture layer, the block id for now
+// Texture coordinates aren't stored, the shader takes them from the position on the face's tangent axes
+inline uint32_t PackVoxelVertex(const glm::ivec3& position, int face, int ao, int layer)
+{
+    return (uint32_t)position.x | (uint32_t)position.y << 6 | (uint32_t)position.z << 12 | (uint32_t)face << 18 | (uint32_t)ao << 21 | (uint32_t)layer << 23;
+}
+
+// A quad as one record of two uint32 for vertex pulling (voxelPull.vs expands it into its 6 vertices from gl_VertexID),
+// 8 bytes per quad against the 16 of its packed vertices plus 24 of indices:
+//  word 0  bits  0-14  x, y, z of the minimum block, 5 bits each
+//          bits 15-17  face (Voxel_Face)
+//          bits 18-27  width - 1 and height - 1, 5 bits each
+//  word 1  bits  0-15  texture layer, the block id for now
+//          bits 16-23  ambient occlusion of the four corners, as VoxelQuad::ao
+inline void PackVoxelFace(const VoxelQuad& quad, uint32_t* record)
+{
+    record[0] = (uint32_t)quad.x | (uint32_t)quad.y << 5 | (uint32_t)quad.z << 10 | (uint32_t)quad.face << 15
+        | (uint32_t)(quad.width - 1) << 18 | (uint32_t)(quad.height - 1) << 23;
+    record[1] = (uint32_t)quad.block | (uint32_t)quad.ao << 16;
+}
+
+// How a chunk mesh is laid out for the GPU
+enum Voxel_Mesh_Format {
+    VOXEL_PACKED_VERTICES,  // 4 PackVoxelVertex per quad, drawn indexed with voxel.vs
+    VOXEL_PULLED_FACES      // one PackVoxelFace record per quad, read from a buffer texture by voxelPull.vs
+};
+
+// every quad's 4 vertices are drawn as triangles 0 1 2 and 0 2 3, the same 6 indices for every quad
+const int VOXEL_QUAD_INDICES[6] = { 0, 1, 2, 0, 2, 3 };
+
+// the corners of a face in VoxelQuad order, as steps along its first and second tangent
+const int VOXEL_CORNER_STEPS[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+
+// A chunk's mesh plus how well it compressed
+struct ChunkMesh {
+    glm::ivec3 Position = glm::ivec3(0);
+    std::vector<VoxelQuad> Quads;
+    unsigned int VisibleFaces = 0;     // block faces not hidden by an opaque neighbor, the quad count of a naive mesher
+    // Quads are grouped by Voxel_Face: Quads[FaceStart[f]] up to Quads[FaceStart[f + 1]] all face along f, so the renderer can
+    // skip everything facing away from the camera as whole ranges
+    unsigned int FaceStart[7] = {};
+
+    unsigned int FaceQuads(int face) const { return FaceStart[face + 1] - FaceStart[face]; }
+
+    // sorts the quads by face (stable) and sets FaceStart, for meshers that don't emit them face by face
+    void GroupByFace()
+    {
+        unsigned int counts[6] = {};
+        for (const VoxelQuad& quad : Quads)
+            counts[quad.face]++;
+        FaceStart[0] = 0;
+        for (int face = 0; face < 6; face++)
+            FaceStart[face + 1] = FaceStart[face] + counts[face];
+
+        std::vector<VoxelQuad> grouped(Quads.size());
+        unsigned int next[6];
+        std::copy(FaceStart, FaceStart + 6, next);
+        for (const VoxelQuad& quad : Quads)
+            grouped[next[quad.face]++] = quad;
+        Quads.swap(grouped);
+    }
+
+    // 4 packed vertices per quad, for drawing with VOXEL_QUAD_INDICES
+    void AppendPackedVertices(std::vector<uint32_t>& vertices) const
+    {
+        for (const VoxelQuad& quad : Quads) {
+            int d = quad.face / 2;
+            int u = (d + 1) % 3, v = (d + 2) % 3;
+            bool positive = quad.face % 2 == 0;
+
+            glm::ivec3 base(quad.x, quad.y, quad.z);
+            if (positive)
+                base[d] += 1;
+            glm::ivec3 du(0), dv(0);
+            du[u] = quad.width;
+            dv[v] = quad.height;
+            glm::ivec3 corners[4] = { base, base + du, base + du + dv, base + dv };
+
+            // u x v points along +d, so 0 1 2 3 is counter-clockwise seen from outside a positive face and 0 3 2 1 from outside
+            // a negative one. The quad is split along its darker diagonal, otherwise the occlusion gradient shows the split
+            int start = quad.CornerOcclusion(0) + quad.CornerOcclusion(2) > quad.CornerOcclusion(1) + quad.CornerOcclusion(3) ? 1 : 0;
+            for (int i = 0; i < 4; i++) {
+                int corner = positive ? (start + i) % 4 : (start + 4 - i) % 4;
+                vertices.push_back(PackVoxelVertex(corners[corner], quad.face, quad.CornerOcclusion(corner), quad.block));
+            }
+        }
+    }
+
+    // 2 words per quad, see PackVoxelFace
+    void AppendPackedFaces(std::vector<uint32_t>& records) const
+    {
+        size_t first = records.size();
+        records.resize(first + Quads.size() * 2);
+        for (size_t i = 0; i < Quads.size(); i++)
+            PackVoxelFace(Quads[i], &records[first + i * 2]);
+    }
+
+    void AppendPacked(Voxel_Mesh_Format format, std::vector<uint32_t>& data) const
+    {
+        if (format == VOXEL_PULLED_FACES)
+            AppendPackedFaces(data);
+        else
+            AppendPackedVertices(data);
+    }
+};
+
+
+// Copy of a chunk's blocks and the single layer of blocks bordering it in the six face neighbors, so the mesher never
+// touches the live world. Missing neighbors (not loaded yet) count as air, which shows the faces on that border.
+// Edge and corner cells of the border stay air: face culling never looks at them, ambient occlusion does and comes out a
+// little too bright along the chunk's edges
+struct ChunkSnapshot {
+    glm::ivec3 Position = glm::ivec3(0);
+    BlockId Blocks[SNAPSHOT_SIZE * SNAPSHOT_SIZE * SNAPSHOT_SIZE];
+
+    // x, y, z in -1..CHUNK_SIZE
+    static int Index(int x, int y, int z) { return ((y + 1) * SNAPSHOT_SIZE + z + 1) * SNAPSHOT_SIZE + x + 1; }
+
+    BlockId At(int x, int y, int z) const { return Blocks[Index(x, y, z)]; }
+
+    // ambient occlusion of the face of block (x, y, z) as stored in VoxelQuad::ao. Each corner is darkened by the blocks
+    // touching it in the layer in front of the face: the two along the edges and the diagonal one
+    uint8_t FaceOcclusion(int x, int y, int z, int face) const
+    {
+        static const int strides[3] = { 1, SNAPSHOT_SIZE * SNAPSHOT_SIZE, SNAPSHOT_SIZE };
+        int d = face / 2;
+        const BlockId* front = &Blocks[Index(x, y, z) + (face % 2 == 0 ? strides[d] : -strides[d])];
+        int alongU = strides[(d + 1) % 3], alongV = strides[(d + 2) % 3];
+
+        uint8_t ao = 0;
+        for (int corner = 0; corner < 4; corner++) {
+            int stepU = VOXEL_CORNER_STEPS[corner][0] * alongU, stepV = VOXEL_CORNER_STEPS[corner][1] * alongV;
+            int side1 = IsOpaque(front[stepU]), side2 = IsOpaque(front[stepV]), diagonal = IsOpaque(front[stepU + stepV]);
+            int level = side1 && side2 ? 0 : 3 - side1 - side2 - diagonal;
+            ao |= (uint8_t)(level << (corner * 2));
+        }
+        return ao;
+    }
+
+    // neighbors are indexed by Voxel_Face and may be null
+    void Capture(const Chunk& chunk, const Chunk* const neighbors[6])
+    {
+        Position = chunk.Position;
+        std::memset(Blocks, 0, sizeof(Blocks));
+
+        BlockId section[SECTION_VOLUME];
+        for (int sy = 0; sy < CHUNK_SECTIONS; sy++)
+            for (int sz = 0; sz < CHUNK_SECTIONS; sz++)
+                for (int sx = 0; sx < CHUNK_SECTIONS; sx++) {
+                    chunk.Section(sx, sy, sz).Decode(section);
+                    const BlockId* row = section;
+                    for (int y = 0; y < SECTION_SIZE; y++)
+                        for (int z = 0; z < SECTION_SIZE; z++, row += SECTION_SIZE)
+                            std::memcpy(&Blocks[Index(sx * SECTION_SIZE, sy * SECTION_SIZE + y, sz * SECTION_SIZE + z)], row, SECTION_SIZE * sizeof(BlockId));
+                }
+
+        const int last = CHUNK_SIZE - 1;
+        for (int a = 0; a < CHUNK_SIZE; a++)
+            for (int b = 0; b < CHUNK_SIZE; b++) {
+                if (neighbors[FACE_POS_X]) Blocks[Index(CHUNK_SIZE, a, b)] = neighbors[FACE_POS_X]->Get(0, a, b);
+                if (neighbors[FACE_NEG_X]) Blocks[Index(-1, a, b)] = neighbors[FACE_NEG_X]->Get(last, a, b);
+                if (neighbors[FACE_POS_Y]) Blocks[Index(a, CHUNK_SIZE, b)] = neighbors[FACE_POS_Y]->Get(a, 0, b);
+                if (neighbors[FACE_NEG_Y]) Blocks[Index(a, -1, b)] = neighbors[FACE_NEG_Y]->Get(a, last, b);
+                if (neighbors[FACE_POS_Z]) Blocks[Index(a, b, CHUNK_SIZE)] = neighbors[FACE_POS_Z]->Get(a, b, 0);
+                if (neighbors[FACE_NEG_Z]) Blocks[Index(a, b, -1)] = neighbors[FACE_NEG_Z]->Get(a, b, last);
+            }
+    }
+};
+
+
+// Turns chunk snapshots into quads. Faces between two opaque blocks are dropped, and the visible faces of every slice are
+// merged greedily: a run of equal faces (same block, same corner occlusion) is grown along the first tangent as far as it goes, then row by row along the
+// second while the whole row still matches, and the covered faces are taken out of the slice.
+// Mesh does this block by block; MeshBinary gives the same quads working on 64-bit masks and is the one to use.
+class ChunkMesher
+{
+public:
+    void Mesh(const ChunkSnapshot& snapshot, ChunkMesh& mesh)
+    {
+        mesh.Position = snapshot.Position;
+        mesh.Quads.clear();
+        mesh.VisibleFaces = 0;
+
+        // distance between neighboring cells of the snapshot along x, y and z
+        const int strides[3] = { 1, SNAPSHOT_SIZE * SNAPSHOT_SIZE, SNAPSHOT_SIZE };
+        for (int face = 0; face < 6; face++) {
+            mesh.FaceStart[face] = (unsigned int)mesh.Quads.size();
+            int d = face / 2;
+            int u = (d + 1) % 3, v = (d + 2) % 3;
+            int toNeighbor = face % 2 == 0 ? strides[d] : -strides[d];
+
+            for (int slice = 0; slice < CHUNK_SIZE; slice++) {
+                // which block and occlusion each cell of the slice shows a face with (faceKey), 0 where none
+                int sliceStart = ChunkSnapshot::Index(0, 0, 0) + slice * strides[d];
+                for (int j = 0; j < CHUNK_SIZE; j++) {
+                    const BlockId* cell = &snapshot.Blocks[sliceStart + j * strides[v]];
+                    uint32_t* row = &mask[j * CHUNK_SIZE];
+                    for (int i = 0; i < CHUNK_SIZE; i++, cell += strides[u]) {
+                        row[i] = 0;
+                        if (!IsOpaque(*cell) || IsOpaque(cell[toNeighbor]))
+                            continue;
+                        glm::ivec3 position;
+                        position[d] = slice;
+                        position[u] = i;
+                        position[v] = j;
+                        row[i] = faceKey(*cell, snapshot.FaceOcclusion(position.x, position.y, position.z, face));
+                        mesh.VisibleFaces++;
+                    }
+                }
+                mergeSlice(face, d, u, v, slice, mesh);
+            }
+        }
+        mesh.FaceStart[6] = (unsigned int)mesh.Quads.size();
+    }
+
+    // Mesh on bits. Every row of the snapshot along x becomes a 64-bit occupancy mask (34 bits used), so the visible faces of
+    // 32 blocks come out of one shift or neighbor row and an AND-NOT: solid & ~(solid >> 1) are the blocks whose +x
+    // neighbor is empty, solid & ~(row above) those whose +y neighbor is. Those faces are scattered into 32x32 bit planes
+    // per face direction, slice and block type (with occlusion), and the greedy merge finds runs with bit scans and grows them over whole
+    // rows at once
+    void MeshBinary(const ChunkSnapshot& snapshot, ChunkMesh& mesh)
+    {
+        mesh.Position = snapshot.Position;
+        mesh.Quads.clear();
+        mesh.VisibleFaces = 0;
+
+        // occupancy[y * SNAPSHOT_SIZE + z] has bit x set when block (x, y, z) is opaque, in snapshot coordinates
+        const BlockId* row = snapshot.Blocks;
+        for (int i = 0; i < SNAPSHOT_SIZE * SNAPSHOT_SIZE; i++, row += SNAPSHOT_SIZE)
+            occupancy[i] = occupancyBits(row);
+
+        slotKeys.clear();
+        usedSlices.clear();
+        for (int y = 0; y < CHUNK_SIZE; y++)
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                int center = (y + 1) * SNAPSHOT_SIZE + z + 1;
+                uint64_t solid = occupancy[center];
+                if (solid == 0)
+                    continue;
+
+                // by Voxel_Face, shifted so bit x is block x of the chunk
+                uint32_t faces[6] = {
+                    (uint32_t)((solid & ~(solid >> 1)) >> 1),
+                    (uint32_t)((solid & ~(solid << 1)) >> 1),
+                    (uint32_t)((solid & ~occupancy[center + SNAPSHOT_SIZE]) >> 1),
+                    (uint32_t)((solid & ~occupancy[center - SNAPSHOT_SIZE]) >> 1),
+                    (uint32_t)((solid & ~occupancy[center + 1]) >> 1),
+                    (uint32_t)((solid & ~occupancy[center - 1]) >> 1)
+                };
+                const BlockId* blocks = &snapshot.Blocks[ChunkSnapshot::Index(0, y, z)];
+                for (int face = 0; face < 6; face++) {
+                    if (faces[face] == 0)
+                        continue;
+                    mesh.VisibleFaces += CountSetBits(faces[face]);
+
+                    // occlusion of all 32 faces at once, same rule as ChunkSnapshot::FaceOcclusion: per corner the two edge
+                    // neighbors and the diagonal one in front of the face are summed bit-sliced, and 3 - sum is just the
+                    // complement of the 2-bit sum, forced to 0 when both edge neighbors are there
+                    int d = face / 2;
+                    glm::ivec3 normal(0), alongU(0), alongV(0);
+                    normal[d] = face % 2 == 0 ? 1 : -1;
+                    alongU[(d + 1) % 3] = 1;
+                    alongV[(d + 2) % 3] = 1;
+                    uint32_t levelLow[4], levelHigh[4];
+                    for (int corner = 0; corner < 4; corner++) {
+                        glm::ivec3 stepU = alongU * VOXEL_CORNER_STEPS[corner][0], stepV = alongV * VOXEL_CORNER_STEPS[corner][1];
+                        uint32_t side1 = neighborBits(y, z, normal + stepU);
+                        uint32_t side2 = neighborBits(y, z, normal + stepV);
+                        uint32_t diagonal = neighborBits(y, z, normal + stepU + stepV);
+                        uint32_t bothSides = side1 & side2;
+                        levelLow[corner] = ~(side1 ^ side2 ^ diagonal) & ~bothSides;
+                        levelHigh[corner] = ~(bothSides | (side1 & diagonal) | (side2 & diagonal));
+                    }
+
+                    for (uint32_t bits = faces[face]; bits != 0; bits &= bits - 1) {
+                        int x = LowestSetBit(bits);
+                        uint8_t ao = 0;
+                        for (int corner = 0; corner < 4; corner++)
+                            ao |= (uint8_t)((((levelLow[corner] >> x) & 1) | ((levelHigh[corner] >> x) & 1) << 1) << (corner * 2));
+
+                        int position[3] = { x, y, z };
+                        int slot = planeSlot(faceKey(blocks[x], ao));
+                        plane(slot, face, position[d])[position[(d + 2) % 3]] |= 1u << position[(d + 1) % 3];
+                        usedSlices[slot * 6 + face] |= 1u << position[d];
+                    }
+                }
+            }
+
+        // face by face, so the quads come out grouped for ChunkMesh::FaceStart
+        for (int face = 0; face < 6; face++) {
+            mesh.FaceStart[face] = (unsigned int)mesh.Quads.size();
+            for (int slot = 0; slot < (int)slotKeys.size(); slot++) {
+                for (uint32_t slices = usedSlices[slot * 6 + face]; slices != 0; slices &= slices - 1) {
+                    int slice = LowestSetBit(slices);
+                    mergePlane(plane(slot, face, slice), slotKeys[slot], face, slice, mesh);
+                }
+            }
+        }
+        mesh.FaceStart[6] = (unsigned int)mesh.Quads.size();
+    }
+
+    // one quad per visible face, what meshing without the merge gives
+    void MeshNaive(const ChunkSnapshot& snapshot, ChunkMesh& mesh)
+    {
+        mesh.Position = snapshot.Position;
+        mesh.Quads.clear();
+        mesh.VisibleFaces = 0;
+
+        for (int y = 0; y < CHUNK_SIZE; y++)
+            for (int z = 0; z < CHUNK_SIZE; z++)
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    BlockId block = snapshot.At(x, y, z);
+                    if (!IsOpaque(block))
+                        continue;
+                    for (int face = 0; face < 6; face++) {
+                        glm::ivec3 neighbor(x, y, z);
+                        neighbor[face / 2] += face % 2 == 0 ? 1 : -1;
+                        if (IsOpaque(snapshot.At(neighbor.x, neighbor.y, neighbor.z)))
+                            continue;
+                        VoxelQuad quad = { (uint8_t)x, (uint8_t)y, (uint8_t)z, (uint8_t)face, 1, 1, snapshot.FaceOcclusion(x, y, z, face), block };
+                        mesh.Quads.push_back(quad);
+                        mesh.VisibleFaces++;
+                    }
+                }
+        mesh.GroupByFace();
+    }
+
+private:
+    static const int PLANE_WORDS = 6 * CHUNK_SIZE * CHUNK_SIZE;   // rows of all slices of all faces of one face key
+
+    uint32_t mask[CHUNK_SIZE * CHUNK_SIZE];
+    uint64_t occupancy[SNAPSHOT_SIZE * SNAPSHOT_SIZE];
+    std::vector<uint32_t> planes;       // PLANE_WORDS per slot, all zero between calls since merging clears every bit
+    std::vector<uint32_t> slotKeys;     // face key of each slot
+    int lastSlot = 0;
+    std::vector<uint32_t> usedSlices;   // 6 per slot, bit s set when the plane of slice s for that face has any bit set
+
+    // bit x set for every opaque block of a snapshot row
+    static uint64_t occupancyBits(const BlockId* row)
+    {
+#if defined(__AVX2__)
+        // IsOpaque for 32 blocks at once: air compares equal to zero, and the 16-bit results are packed to bytes (per 128-bit
+        // lane, hence the permute) for the byte mask
+        __m256i zero = _mm256_setzero_si256();
+        __m256i air = _mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)row), zero),
+            _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(row + 16)), zero));
+        uint32_t solid = ~(uint32_t)_mm256_movemask_epi8(_mm256_permute4x64_epi64(air, 0xD8));
+        uint64_t bits = solid;
+        for (int x = 32; x < SNAPSHOT_SIZE; x++)
+            bits |= (uint64_t)IsOpaque(row[x]) << x;
+        return bits;
+#else
+        uint64_t bits = 0;
+        for (int x = 0; x < SNAPSHOT_SIZE; x++)
+            bits |= (uint64_t)IsOpaque(row[x]) << x;
+        return bits;
+#endif
+    }
+
+    // what a face must match to merge with another, never 0 since the block is opaque
+    static uint32_t faceKey(BlockId block, uint8_t ao) { return (uint32_t)block | (uint32_t)ao << 16; }
+
+    static VoxelQuad makeQuad(const glm::ivec3& corner, int face, int width, int height, uint32_t key)
+    {
+        VoxelQuad quad = { (uint8_t)corner.x, (uint8_t)corner.y, (uint8_t)corner.z, (uint8_t)face, (uint8_t)width, (uint8_t)height, (uint8_t)(key >> 16), (BlockId)(key & 0xFFFF) };
+        return quad;
+    }
+
+    // bit x set when block (x, y, z) + offset is opaque, for the chunk's blocks x = 0..31 and offsets of at most one block
+    uint32_t neighborBits(int y, int z, const glm::ivec3& offset) const
+    {
+        return (uint32_t)(occupancy[(y + 1 + offset.y) * SNAPSHOT_SIZE + z + 1 + offset.z] >> (1 + offset.x));
+    }
+
+    uint32_t* plane(int slot, int face, int slice)
+    {
+        return &planes[(size_t)slot * PLANE_WORDS + (face * CHUNK_SIZE + slice) * CHUNK_SIZE];
+    }
+
+    int planeSlot(uint32_t key)
+    {
+        // neighboring faces mostly share their key
+        if (!slotKeys.empty() && slotKeys[lastSlot] == key)
+            return lastSlot;
+        for (int slot = (int)slotKeys.size() - 1; slot >= 0; slot--) {
+            if (slotKeys[slot] == key) {
+                lastSlot = slot;
+                return slot;
+            }
+        }
+        slotKeys.push_back(key);
+        usedSlices.resize(slotKeys.size() * 6, 0);
+        if (planes.size() < slotKeys.size() * PLANE_WORDS)
+            planes.resize(slotKeys.size() * PLANE_WORDS, 0);
+        lastSlot = (int)slotKeys.size() - 1;
+        return lastSlot;
+    }
+
+    // greedy merge of one slice's bit rows (bit i of row j is the face at u = i, v = j), clearing the rows as it goes
+    void mergePlane(uint32_t* rows, uint32_t key, int face, int slice, ChunkMesh& mesh)
+    {
+        int d = face / 2;
+        int u = (d + 1) % 3, v = (d + 2) % 3;
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            while (rows[j] != 0) {
+                int i = LowestSetBit(rows[j]);
+                // the 64-bit complement has ones above bit 31, so a run reaching the end still stops there
+                int width = LowestSetBit(~(uint64_t)(rows[j] >> i));
+                uint32_t run = (uint32_t)((((uint64_t)1 << width) - 1) << i);
+                rows[j] &= ~run;
+
+                int height = 1;
+                while (j + height < CHUNK_SIZE && (rows[j + height] & run) == run) {
+                    rows[j + height] &= ~run;
+                    height++;
+                }
+
+                glm::ivec3 corner;
+                corner[d] = slice;
+                corner[u] = i;
+                corner[v] = j;
+                mesh.Quads.push_back(makeQuad(corner, face, width, height, key));
+            }
+        }
+    }
+
+    void mergeSlice(int face, int d, int u, int v, int slice, ChunkMesh& mesh)
+    {
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            for (int i = 0; i < CHUNK_SIZE; ) {
+                uint32_t key = mask[j * CHUNK_SIZE + i];
+                if (key == 0) {
+                    i++;
+                    continue;
+                }
+
+                int width = 1;
+                while (i + width < CHUNK_SIZE && mask[j * CHUNK_SIZE + i + width] == key)
+                    width++;
+
+                int height = 1;
+                for (; j + height < CHUNK_SIZE; height++) {
+                    const uint32_t* row = &mask[(j + height) * CHUNK_SIZE + i];
+                    int k = 0;
+                    while (k < width && row[k] == key)
+                        k++;
+                    if (k < width)
+                        break;
+                }
+
+                for (int h = 0; h < height; h++)
+                    std::memset(&mask[(j + h) * CHUNK_SIZE + i], 0, width * sizeof(uint32_t));
+
+                glm::ivec3 corner;
+                corner[d] = slice;
+                corner[u] = i;
+                corner[v] = j;
+                mesh.Quads.push_back(makeQuad(corner, face, width, height, key));
+                i += width;
+            }
+        }
+    }
+};
+
+
+// Meshes a grid of test terrain chunks (with their neighbors in the grid) on bits, greedily block by block and naively, and
+// compares time and quads
+inline void BenchmarkChunkMeshing(int chunksX, int chunksY, int chunksZ)
+{
+    BenchmarkRandom random(1234u);
+    std::vector<Chunk> chunks;
+    chunks.reserve((size_t)chunksX * chunksY * chunksZ);
+    for (int cy = 0; cy < chunksY; cy++)
+        for (int cz = 0; cz < chunksZ; cz++)
+            for (int cx = 0; cx < chunksX; cx++) {
+                chunks.emplace_back(glm::ivec3(cx, cy, cz));
+                FillTestTerrain(chunks.back(), random);
+            }
+    auto chunkAt = [&](glm::ivec3 p) -> const Chunk* {
+        if (p.x < 0 || p.y < 0 || p.z < 0 || p.x >= chunksX || p.y >= chunksY || p.z >= chunksZ)
+            return nullptr;
+        return &chunks[((size_t)p.y * chunksZ + p.z) * chunksX + p.x];
+    };
+
+    ChunkSnapshot* snapshot = new ChunkSnapshot();
+    ChunkMesher mesher;
+    ChunkMesh mesh;
+    size_t greedyQuads = 0, naiveQuads = 0, visibleFaces = 0;
+    double captureMs = 0.0, binaryMs = 0.0, greedyMs = 0.0, naiveMs = 0.0;
+
+    for (const Chunk& chunk : chunks) {
+        const Chunk* neighbors[6] = {
+            chunkAt(chunk.Position + glm::ivec3(1, 0, 0)), chunkAt(chunk.Position - glm::ivec3(1, 0, 0)),
+            chunkAt(chunk.Position + glm::ivec3(0, 1, 0)), chunkAt(chunk.Position - glm::ivec3(0, 1, 0)),
+            chunkAt(chunk.Position + glm::ivec3(0, 0, 1)), chunkAt(chunk.Position - glm::ivec3(0, 0, 1))
+        };
+        auto start = std::chrono::high_resolution_clock::now();
+        snapshot->Capture(chunk, neighbors);
+        auto captureEnd = std::chrono::high_resolution_clock::now();
+        mesher.MeshBinary(*snapshot, mesh);
+        auto binaryEnd = std::chrono::high_resolution_clock::now();
+        mesher.Mesh(*snapshot, mesh);
+        auto greedyEnd = std::chrono::high_resolution_clock::now();
+        greedyQuads += mesh.Quads.size();
+        visibleFaces += mesh.VisibleFaces;
+        mesher.MeshNaive(*snapshot, mesh);
+        auto naiveEnd = std::chrono::high_resolution_clock::now();
+        naiveQuads += mesh.Quads.size();
+
+        captureMs += BenchmarkMs(start, captureEnd);
+        binaryMs += BenchmarkMs(captureEnd, binaryEnd);
+        greedyMs += BenchmarkMs(binaryEnd, greedyEnd);
+        naiveMs += BenchmarkMs(greedyEnd, naiveEnd);
+    }
+    delete snapshot;
+
+    double n = (double)chunks.size();
+    std::cout << "BENCHMARK::CHUNK_MESHING " << chunks.size() << " chunks, " << visibleFaces << " visible faces" << std::endl;
+    std::cout << "  snapshot: " << captureMs * 1000.0 / n << " us per chunk" << std::endl;
+    std::cout << "  binary: " << binaryMs * 1000.0 / n << " us per chunk" << std::endl;
+    std::cout << "  greedy: " << greedyMs * 1000.0 / n << " us per chunk, " << greedyQuads << " quads (" << greedyQuads / n << " per chunk)" << std::endl;
+    std::cout << "  naive: " << naiveMs * 1000.0 / n << " us per chunk, " << naiveQuads << " quads (" << naiveQuads / n << " per chunk), "
+        << (double)naiveQuads / std::max<size_t>(greedyQuads, 1) << "x the greedy count" << std::endl;
+}
+
+#endif
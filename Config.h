@@ -1,3 +1,9 @@
+// Uncomment to run the CPU benchmarks at startup and exit instead of opening a window
+// #define RUN_BENCHMARKS
+
+// Uncomment to print frame statistics (input latency etc.) to the console once a second
+// #define PRINT_FRAME_STATS
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
@@ -6,5 +12,28 @@
 #include <glm/gtc/type_ptr.hpp>
 #include "Shader.h"
 #include "Camera.h"
+#include "InputLatch.h"
+#include "PreciseSleep.h"
+#include "Simulation.h"
+#include "FramePacer.h"
+#include "RenderTargetPool.h"
+#include "DynamicResolution.h"
+#include "FrameGraph.h"
+#include "OcclusionCuller.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "Benchmark.h"
+#include "Transform.h"
+#include "JobSystem.h"
+#include "MaskedOcclusion.h"
+#include "SpatialIndex.h"
+#include "VoxelChunk.h"
+#include "ChunkMesher.h"
+#include "MpscQueue.h"
+#include "MeshingPipeline.h"
+#include "GpuBufferArena.h"
+#include "VoxelRenderer.h"
+#include "TerrainGenerator.h"
+#include "ChunkManager.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
\ No newline at end of file
@@ -0,0 +1,162 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "RenderTargetPool.h"
+
+// Default dynamic resolution values
+const double DRS_GPU_BUDGET = 0.8 / 60.0;  // seconds of GPU scene time to aim for, with headroom below a 60 fps frame
+const float DRS_MIN_SCALE = 0.5f;          // lowest render scale per axis
+const float DRS_MAX_SCALE = 1.0f;
+const float DRS_SMOOTHING = 0.2f;          // fraction of the way to the ideal scale moved per measurement
+const float DRS_DEAD_ZONE = 0.02f;         // scale changes smaller than this are ignored to avoid shimmering
+const int GPU_TIMER_QUERIES = 4;           // ring of timer queries, results are read a few frames late so nothing stalls
+
+
+// Measures GPU time between Begin and End with GL_TIME_ELAPSED queries (core in GL 3.3). Results are only read once the driver
+// reports them available, so the CPU never waits on the GPU; the latest finished measurement is kept in LastTime.
+// Constructed with GL_SAMPLES_PASSED instead it counts the fragments passing the depth test, kept in LastResult
+class GpuTimer
+{
+public:
+    double LastTime = 0.0;      // seconds
+    GLuint64 LastResult = 0;    // raw query result (nanoseconds or samples)
+    bool HasResult = false;
+
+    GpuTimer(GLenum target = GL_TIME_ELAPSED) : target(target)
+    {
+        glGenQueries(GPU_TIMER_QUERIES, queries);
+    }
+
+    ~GpuTimer()
+    {
+        glDeleteQueries(GPU_TIMER_QUERIES, queries);
+    }
+
+    void Begin()
+    {
+        // the slot is still busy when the GPU is more than GPU_TIMER_QUERIES frames behind, skip measuring this frame
+        active = !pending[next];
+        if (active)
+            glBeginQuery(target, queries[next]);
+    }
+
+    void End()
+    {
+        if (active) {
+            glEndQuery(target);
+            pending[next] = true;
+            next = (next + 1) % GPU_TIMER_QUERIES;
+        }
+    }
+
+    // collects every finished query, returns true if a new measurement arrived
+    bool Poll()
+    {
+        bool updated = false;
+        for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+            int slot = (next + i) % GPU_TIMER_QUERIES;  // oldest first
+            if (!pending[slot])
+                continue;
+
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &LastResult);
+            LastTime = (double)LastResult * 1e-9;
+            HasResult = true;
+            pending[slot] = false;
+            updated = true;
+        }
+        return updated;
+    }
+
+private:
+    GLenum target;
+    unsigned int queries[GPU_TIMER_QUERIES];
+    bool pending[GPU_TIMER_QUERIES] = {};
+    int next = 0;
+    bool active = false;
+};
+
+
+// Renders the scene into an offscreen framebuffer at a fraction of the window size and upscales it to the backbuffer. The scale
+// follows the measured GPU time of the scene toward DRS_GPU_BUDGET, so a heavy scene costs resolution instead of frame rate.
+//
+// The scene targets are frame graph textures at the pool's full (debounced) size and the scene is drawn into the lower left
+// scaled rectangle, so changing the scale never reallocates anything.
+class DynamicResolution
+{
+public:
+    double GpuBudget;
+    float Scale = DRS_MAX_SCALE;
+    bool Enabled = true;
+
+    DynamicResolution(RenderTargetPool& pool, double gpuBudget = DRS_GPU_BUDGET) : GpuBudget(gpuBudget), pool(pool)
+    {
+    }
+
+    // render size for a window of the given size, never larger than the pooled targets (which lag behind during a resize)
+    int RenderWidth() const { return renderWidth; }
+    int RenderHeight() const { return renderHeight; }
+
+    // sets the viewport to the current render size inside the already bound scene framebuffer and starts timing
+    void BeginScene(int windowWidth, int windowHeight)
+    {
+        float scale = Enabled ? Scale : 1.0f;
+        presentWidth = windowWidth;
+        presentHeight = windowHeight;
+        renderWidth = std::min(std::max(1, (int)(windowWidth * scale)), pool.Width());
+        renderHeight = std::min(std::max(1, (int)(windowHeight * scale)), pool.Height());
+
+        glViewport(0, 0, renderWidth, renderHeight);
+        timer.Begin();
+    }
+
+    void EndScene()
+    {
+        timer.End();
+    }
+
+    // bilinear upscale of the rendered rectangle of sourceFramebuffer onto the whole default framebuffer
+    void Present(unsigned int sourceFramebuffer)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, presentWidth, presentHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, presentWidth, presentHeight);
+    }
+
+    // picks the scale for the next frames from the newest GPU measurement. Cost is roughly proportional to pixel count, i.e. to
+    // scale squared, so the ideal scale is the current one times sqrt(budget / time)
+    void Update()
+    {
+        if (!timer.Poll() || !Enabled || timer.LastTime <= 0.0)
+            return;
+
+        float ideal = Scale * (float)std::sqrt(GpuBudget / timer.LastTime);
+        ideal = std::min(std::max(ideal, DRS_MIN_SCALE), DRS_MAX_SCALE);
+        if (std::fabs(ideal - Scale) >= DRS_DEAD_ZONE)
+            Scale += (ideal - Scale) * DRS_SMOOTHING;
+    }
+
+    double LastGpuTime() const { return timer.LastTime; }
+
+private:
+    RenderTargetPool& pool;
+    int renderWidth = 1;
+    int renderHeight = 1;
+    int presentWidth = 1;
+    int presentHeight = 1;
+    GpuTimer timer;
+};
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+// Handle of a texture inside one frame's graph
+typedef int FrameResource;
+
+class FrameGraph;
+
+// glInvalidateFramebuffer is GL 4.3 / ARB_invalidate_subdata, so it is not in the GL 3.3 glad loader and is fetched by hand
+typedef void (APIENTRYP PFN_INVALIDATE_FRAMEBUFFER)(GLenum target, GLsizei numAttachments, const GLenum* attachments);
+
+
+// How a transient texture of the graph looks and whether its first writer gets it cleared
+struct FrameTextureDesc {
+    RenderTargetDesc target;
+    bool clear = false;
+    glm::vec4 clearColor = glm::vec4(0.0f);
+    float clearDepth = 1.0f;
+};
+
+
+// Given to a pass's setup callback to declare what the pass touches
+class FramePassBuilder
+{
+public:
+    void Read(FrameResource resource) { reads->push_back(resource); }
+    void Write(FrameResource resource) { writes->push_back(resource); }
+    // keeps the pass even if nothing reads its outputs (readbacks, queries, ...)
+    void SideEffect() { *sideEffect = true; }
+
+private:
+    friend class FrameGraph;
+    std::vector<FrameResource>* reads;
+    std::vector<FrameResource>* writes;
+    bool* sideEffect;
+};
+
+
+// Given to a pass's execute callback; resolves graph handles to the GL objects backing them this frame
+class FramePassContext
+{
+public:
+    unsigned int Texture(FrameResource resource) const;
+    // framebuffer holding only resource as its attachment, e.g. as the read side of a blit
+    unsigned int Framebuffer(FrameResource resource) const;
+    // framebuffer the pass's writes are bound to (already bound when execute runs)
+    unsigned int PassFramebuffer() const { return passFramebuffer; }
+
+private:
+    friend class FrameGraph;
+    FrameGraph* graph = nullptr;
+    unsigned int passFramebuffer = 0;
+};
+
+
+// Declarative per-frame render graph. Passes are added in submission order with the textures they read and write; Execute then
+//  - culls passes whose results never reach the backbuffer (or another pass with a side effect),
+//  - acquires each transient texture from the render target pool right before its first use and releases it right after its last,
+//    so textures with disjoint lifetimes and the same descriptor share memory (GL has no heaps, so aliasing is per descriptor),
+//  - clears a texture on its first write only when its descriptor asks for it,
+//  - invalidates attachments after their last use where glInvalidateFramebuffer exists, so tilers don't write them back.
+// The graph is rebuilt every frame: Reset, AddPass..., Execute.
+class FrameGraph
+{
+public:
+    // statistics of the last Execute
+    unsigned int PassesExecuted = 0;
+    unsigned int PassesCulled = 0;
+    unsigned int TexturesAliased = 0;
+    unsigned int Invalidates = 0;
+
+    FrameGraph(RenderTargetPool& pool) : pool(pool)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 3) || glfwExtensionSupported("GL_ARB_invalidate_subdata"))
+            invalidateFramebuffer = (PFN_INVALIDATE_FRAMEBUFFER)glfwGetProcAddress("glInvalidateFramebuffer");
+    }
+
+    void Reset()
+    {
+        passes.clear();
+        resources.clear();
+    }
+
+    FrameResource CreateTexture(const std::string& name, const FrameTextureDesc& desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resources.push_back(resource);
+        return (FrameResource)resources.size() - 1;
+    }
+
+    // the default framebuffer; passes writing it are always kept
+    FrameResource ImportBackbuffer()
+    {
+        Resource resource;
+        resource.name = "backbuffer";
+        resource.imported = true;
+        resources.push_back(resource);
+        return (FrameResource)resources.size() - 1;
+    }
+
+    void AddPass(const std::string& name, const std::function<void(FramePassBuilder&)>& setup, const std::function<void(const FramePassContext&)>& execute)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.execute = execute;
+        passes.push_back(pass);
+
+        FramePassBuilder builder;
+        builder.reads = &passes.back().reads;
+        builder.writes = &passes.back().writes;
+        builder.sideEffect = &passes.back().sideEffect;
+        setup(builder);
+    }
+
+    void Execute()
+    {
+        PassesExecuted = 0;
+        PassesCulled = 0;
+        TexturesAliased = 0;
+        Invalidates = 0;
+
+        cull();
+        computeLifetimes();
+
+        std::set<unsigned int> texturesThisFrame;
+        for (int p = 0; p < (int)passes.size(); p++) {
+            Pass& pass = passes[p];
+            if (!pass.live) {
+                PassesCulled++;
+                continue;
+            }
+
+            // materialize everything that starts living here
+            for (Resource& resource : resources) {
+                if (!resource.imported && resource.firstUse == p) {
+                    resource.target = pool.Acquire(resource.desc.target);
+                    if (!texturesThisFrame.insert(resource.target->texture).second)
+                        TexturesAliased++;
+                }
+            }
+
+            FramePassContext context;
+            context.graph = this;
+            context.passFramebuffer = bindWrites(pass, p);
+            pass.execute(context);
+            PassesExecuted++;
+
+            // and hand back everything that dies here
+            for (Resource& resource : resources) {
+                if (!resource.imported && resource.lastUse == p) {
+                    invalidate(resource);
+                    pool.Release(resource.target);
+                    resource.target = nullptr;
+                }
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+private:
+    friend class FramePassContext;
+
+    struct Resource {
+        std::string name;
+        FrameTextureDesc desc;
+        bool imported = false;
+        RenderTarget* target = nullptr;
+        int firstUse = -1;
+        int lastUse = -1;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<FrameResource> reads;
+        std::vector<FrameResource> writes;
+        bool sideEffect = false;
+        bool live = false;
+        std::function<void(const FramePassContext&)> execute;
+    };
+
+    RenderTargetPool& pool;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    PFN_INVALIDATE_FRAMEBUFFER invalidateFramebuffer = nullptr;
+
+    static bool isDepth(const Resource& resource)
+    {
+        GLenum format = resource.desc.target.internalFormat;
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+            || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    static bool hasStencil(const Resource& resource)
+    {
+        return resource.desc.target.internalFormat == GL_DEPTH24_STENCIL8 || resource.desc.target.internalFormat == GL_DEPTH32F_STENCIL8;
+    }
+
+    // walking backwards, a pass is live if it has a side effect or writes something a live pass (or the screen) needs
+    void cull()
+    {
+        std::vector<bool> needed(resources.size(), false);
+        for (size_t r = 0; r < resources.size(); r++)
+            needed[r] = resources[r].imported;
+
+        for (int p = (int)passes.size() - 1; p >= 0; p--) {
+            Pass& pass = passes[p];
+            pass.live = pass.sideEffect;
+            for (FrameResource write : pass.writes)
+                pass.live = pass.live || needed[write];
+            if (pass.live) {
+                for (FrameResource read : pass.reads)
+                    needed[read] = true;
+            }
+        }
+    }
+
+    void computeLifetimes()
+    {
+        for (Resource& resource : resources) {
+            resource.firstUse = -1;
+            resource.lastUse = -1;
+        }
+        for (int p = 0; p < (int)passes.size(); p++) {
+            if (!passes[p].live)
+                continue;
+            for (const std::vector<FrameResource>* list : { &passes[p].reads, &passes[p].writes }) {
+                for (FrameResource r : *list) {
+                    if (resources[r].firstUse < 0)
+                        resources[r].firstUse = p;
+                    resources[r].lastUse = p;
+                }
+            }
+        }
+    }
+
+    // binds a framebuffer for the pass's writes (one color, one depth at most) and performs first-write clears
+    unsigned int bindWrites(const Pass& pass, int passIndex)
+    {
+        const Resource* color = nullptr;
+        const Resource* depth = nullptr;
+        bool backbuffer = false;
+        for (FrameResource write : pass.writes) {
+            const Resource& resource = resources[write];
+            if (resource.imported)
+                backbuffer = true;
+            else if (isDepth(resource))
+                depth = &resource;
+            else
+                color = &resource;
+        }
+
+        unsigned int framebuffer = 0;
+        if (!backbuffer && (color || depth))
+            framebuffer = pool.Framebuffer(color ? color->target : nullptr, depth ? depth->target : nullptr);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        GLbitfield clearMask = 0;
+        if (color && color->desc.clear && color->firstUse == passIndex) {
+            glClearColor(color->desc.clearColor.r, color->desc.clearColor.g, color->desc.clearColor.b, color->desc.clearColor.a);
+            clearMask |= GL_COLOR_BUFFER_BIT;
+        }
+        if (depth && depth->desc.clear && depth->firstUse == passIndex) {
+            glClearDepth(depth->desc.clearDepth);
+            clearMask |= GL_DEPTH_BUFFER_BIT | (hasStencil(*depth) ? GL_STENCIL_BUFFER_BIT : 0);
+        }
+        if (clearMask)
+            glClear(clearMask);
+        return framebuffer;
+    }
+
+    void invalidate(const Resource& resource)
+    {
+        if (!invalidateFramebuffer)
+            return;
+
+        GLenum attachment = !isDepth(resource) ? GL_COLOR_ATTACHMENT0 : hasStencil(resource) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        glBindFramebuffer(GL_FRAMEBUFFER, isDepth(resource) ? pool.Framebuffer(nullptr, resource.target) : pool.Framebuffer(resource.target, nullptr));
+        invalidateFramebuffer(GL_FRAMEBUFFER, 1, &attachment);
+        Invalidates++;
+    }
+};
+
+
+inline unsigned int FramePassContext::Texture(FrameResource resource) const
+{
+    const RenderTarget* target = graph->resources[resource].target;
+    return target ? target->texture : 0;
+}
+
+inline unsigned int FramePassContext::Framebuffer(FrameResource resource) const
+{
+    const FrameGraph::Resource& entry = graph->resources[resource];
+    if (entry.imported || !entry.target)
+        return 0;
+    return FrameGraph::isDepth(entry) ? graph->pool.Framebuffer(nullptr, entry.target) : graph->pool.Framebuffer(entry.target, nullptr);
+}
+
+#endif
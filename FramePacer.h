@@ -0,0 +1,132 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "PreciseSleep.h"
+
+// Default pacing values
+const double FRAME_TARGET_FPS = 60.0;       // 0 disables the limiter
+
+// Swap interval modes for FramePacer::SetVSync
+enum VSync_Mode {
+    VSYNC_OFF,
+    VSYNC_ON,
+    VSYNC_ADAPTIVE  // vsync when on time, tear instead of waiting a whole refresh when late (swap interval -1)
+};
+
+
+// Paces the render loop to a target frame rate, sleeping through most of the wait with a PreciseSleeper and spinning the rest.
+// The limiter stands aside while vsync already holds the frame rate at or below the target, so the two don't both wait.
+// Also keeps frame time statistics.
+class FramePacer
+{
+public:
+    double TargetFPS;
+
+    // frame time statistics in seconds since the last ResetStats (Welford's running variance)
+    unsigned int FrameCount = 0;
+    double MeanFrameTime = 0.0;
+    double MinFrameTime = 0.0;
+    double MaxFrameTime = 0.0;
+
+    FramePacer(double targetFps = FRAME_TARGET_FPS) : TargetFPS(targetFps)
+    {
+        lastFrameEnd = clock::now();
+        deadline = lastFrameEnd;
+    }
+
+    // applies the swap interval for mode on the current context. Adaptive vsync falls back to plain vsync without the
+    // swap_control_tear extension. Returns the mode actually in use
+    VSync_Mode SetVSync(VSync_Mode mode)
+    {
+        if (mode == VSYNC_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            mode = VSYNC_ON;
+
+        glfwSwapInterval(mode == VSYNC_ADAPTIVE ? -1 : mode == VSYNC_ON ? 1 : 0);
+        vsyncMode = mode;
+        // the window's monitor when fullscreen, otherwise the primary one is the best guess
+        GLFWwindow* window = glfwGetCurrentContext();
+        GLFWmonitor* monitor = window ? glfwGetWindowMonitor(window) : NULL;
+        const GLFWvidmode* videoMode = glfwGetVideoMode(monitor ? monitor : glfwGetPrimaryMonitor());
+        refreshRate = videoMode ? videoMode->refreshRate : 0;
+        return mode;
+    }
+
+    // true while vsync caps the frame rate at or below TargetFPS, then Wait doesn't add a wait of its own
+    bool VSyncLimits() const
+    {
+        return vsyncMode != VSYNC_OFF && refreshRate > 0 && refreshRate <= TargetFPS;
+    }
+
+    // blocks until this frame's slot starts. Call at the top of the frame, before polling events and sampling input, so the
+    // idle time isn't added between the input being read and the frame being shown
+    void Wait()
+    {
+        if (TargetFPS <= 0.0 || VSyncLimits()) {
+            deadline = clock::now();
+            return;
+        }
+
+        std::chrono::duration<double> frameLength(1.0 / TargetFPS);
+        deadline += std::chrono::duration_cast<clock::duration>(frameLength);
+
+        // a frame that ran long restarts the schedule instead of letting the next frames rush to catch up
+        clock::time_point now = clock::now();
+        if (now > deadline) {
+            deadline = now;
+            return;
+        }
+        sleeper.SleepUntil(deadline);
+    }
+
+    // call once per frame right after glfwSwapBuffers
+    void EndFrame()
+    {
+        clock::time_point now = clock::now();
+        double frameTime = std::chrono::duration<double>(now - lastFrameEnd).count();
+        lastFrameEnd = now;
+
+        FrameCount++;
+        double delta = frameTime - MeanFrameTime;
+        MeanFrameTime += delta / FrameCount;
+        frameTimeM2 += delta * (frameTime - MeanFrameTime);
+        MinFrameTime = FrameCount == 1 ? frameTime : std::min(MinFrameTime, frameTime);
+        MaxFrameTime = std::max(MaxFrameTime, frameTime);
+    }
+
+    double FrameTimeVariance() const
+    {
+        return FrameCount > 1 ? frameTimeM2 / (FrameCount - 1) : 0.0;
+    }
+
+    double FrameTimeStdDev() const
+    {
+        return std::sqrt(FrameTimeVariance());
+    }
+
+    void ResetStats()
+    {
+        FrameCount = 0;
+        MeanFrameTime = 0.0;
+        MinFrameTime = 0.0;
+        MaxFrameTime = 0.0;
+        frameTimeM2 = 0.0;
+    }
+
+private:
+    typedef PreciseSleeper::clock clock;
+
+    PreciseSleeper sleeper;
+    VSync_Mode vsyncMode = VSYNC_OFF;
+    int refreshRate = 0;                // of the monitor the swap interval follows, 0 when unknown
+    clock::time_point lastFrameEnd;
+    clock::time_point deadline;
+    double frameTimeM2 = 0.0;
+};
+
+#endif
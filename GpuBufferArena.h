@@ -0,0 +1,423 @@
+#ifndef GPU_BUFFER_ARENA_H
+#define GPU_BUFFER_ARENA_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "Benchmark.h"
+
+// Default buffer arena values
+const uint32_t GPU_ARENA_BYTES = 32u << 20;             // size of every big buffer, a few of them hold all chunk meshes
+const uint32_t GPU_ARENA_ALIGNMENT = 16;                // every range starts and ends on this many bytes
+const float GPU_ARENA_DEFRAG_THRESHOLD = 0.25f;         // arenas more fragmented than this get compacted by Defragment
+const size_t GPU_ARENA_DEFRAG_BYTES = 1u << 20;         // bytes Defragment moves per call at most
+const int GPU_ARENA_SIZE_CLASSES = 32;                  // free lists by floor(log2(size))
+
+
+// Hands out ranges of one address space [0, capacity) with segregated free lists: free blocks are kept by size class
+// (floor(log2(size))) and by offset. Allocate takes the best fitting block of the request's class, or the smallest one of the
+// next class that has any, and returns the rest to the lists; Free merges a range with the free blocks on both sides. No GL,
+// GpuBufferArena puts a buffer behind it.
+class RangeAllocator
+{
+public:
+    RangeAllocator(uint32_t capacity = 0) : capacity(capacity)
+    {
+        if (capacity > 0)
+            insertFree(0, capacity);
+    }
+
+    uint32_t Capacity() const { return capacity; }
+    uint32_t UsedBytes() const { return capacity - freeBytes; }
+    uint32_t FreeBytes() const { return freeBytes; }
+    unsigned int FreeBlockCount() const { return (unsigned int)freeByOffset.size(); }
+
+    uint32_t LargestFreeBlock() const
+    {
+        for (int sizeClass = GPU_ARENA_SIZE_CLASSES - 1; sizeClass >= 0; sizeClass--) {
+            if (!freeBySize[sizeClass].empty())
+                return freeBySize[sizeClass].rbegin()->first;
+        }
+        return 0;
+    }
+
+    // 0 when all free space is one block, towards 1 the more it is scattered in pieces
+    float Fragmentation() const
+    {
+        return freeBytes > 0 ? 1.0f - (float)LargestFreeBlock() / (float)freeBytes : 0.0f;
+    }
+
+    bool Allocate(uint32_t size, uint32_t& offset)
+    {
+        if (size == 0 || size > freeBytes)
+            return false;
+        int sizeClass = classOf(size);
+        // best fit within the class, any block of a higher class fits
+        auto fit = freeBySize[sizeClass].lower_bound(std::make_pair(size, 0u));
+        if (fit == freeBySize[sizeClass].end()) {
+            int larger = sizeClass + 1;
+            while (larger < GPU_ARENA_SIZE_CLASSES && freeBySize[larger].empty())
+                larger++;
+            if (larger == GPU_ARENA_SIZE_CLASSES)
+                return false;
+            fit = freeBySize[larger].begin();
+        }
+        offset = fit->second;
+        take(offset, fit->first, size);
+        return true;
+    }
+
+    // lowest free range of size that ends at or before limit, for moving an allocation further down
+    bool AllocateBelow(uint32_t size, uint32_t limit, uint32_t& offset)
+    {
+        for (auto it = freeByOffset.begin(); it != freeByOffset.end() && it->first + size <= limit; ++it) {
+            if (it->second >= size) {
+                offset = it->first;
+                take(it->first, it->second, size);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Free(uint32_t offset, uint32_t size)
+    {
+        // merge with the free blocks right before and right after
+        auto next = freeByOffset.lower_bound(offset);
+        if (next != freeByOffset.end() && next->first == offset + size) {
+            size += next->second;
+            removeFree(next->first, next->second);
+        }
+        auto previous = freeByOffset.lower_bound(offset);
+        if (previous != freeByOffset.begin()) {
+            --previous;
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                removeFree(previous->first, previous->second);
+            }
+        }
+        insertFree(offset, size);
+    }
+
+private:
+    uint32_t capacity;
+    uint32_t freeBytes = 0;
+    std::map<uint32_t, uint32_t> freeByOffset;                                  // offset -> size
+    std::set<std::pair<uint32_t, uint32_t>> freeBySize[GPU_ARENA_SIZE_CLASSES];  // (size, offset) per size class
+
+    static int classOf(uint32_t size)
+    {
+        int sizeClass = 0;
+        while (size >>= 1)
+            sizeClass++;
+        return sizeClass;
+    }
+
+    void insertFree(uint32_t offset, uint32_t size)
+    {
+        freeByOffset[offset] = size;
+        freeBySize[classOf(size)].insert(std::make_pair(size, offset));
+        freeBytes += size;
+    }
+
+    void removeFree(uint32_t offset, uint32_t size)
+    {
+        freeByOffset.erase(offset);
+        freeBySize[classOf(size)].erase(std::make_pair(size, offset));
+        freeBytes -= size;
+    }
+
+    // allocates the front of a free block
+    void take(uint32_t offset, uint32_t blockSize, uint32_t size)
+    {
+        removeFree(offset, blockSize);
+        if (blockSize > size)
+            insertFree(offset + size, blockSize - size);
+    }
+};
+
+
+// Suballocates a few big GL buffers (GPU_ARENA_BYTES each) instead of creating a buffer object per mesh, so thousands of chunks
+// share a handful of buffers and draws only rebind when they cross into another arena. Allocations are referred to by handle,
+// because Defragment moves them: it compacts the most fragmented arena by copying allocations from its top into free space
+// further down with glCopyBufferSubData, a bounded number of bytes per call, so users look the offset up when they draw.
+// A new arena is created when no existing one has room.
+class GpuBufferArena
+{
+public:
+    // cumulative statistics
+    size_t BytesMoved = 0;
+    unsigned int Moves = 0;
+    unsigned int AllocationFailures = 0;    // requests bigger than an arena
+
+    GpuBufferArena(uint32_t arenaBytes = GPU_ARENA_BYTES) : arenaBytes(arenaBytes / GPU_ARENA_ALIGNMENT * GPU_ARENA_ALIGNMENT)
+    {
+    }
+
+    ~GpuBufferArena()
+    {
+        for (Arena& arena : arenas)
+            glDeleteBuffers(1, &arena.buffer);
+    }
+
+    GpuBufferArena(const GpuBufferArena&) = delete;
+    GpuBufferArena& operator=(const GpuBufferArena&) = delete;
+
+    // handle of size bytes (rounded up to GPU_ARENA_ALIGNMENT), -1 if it is bigger than an arena
+    int Allocate(uint32_t size)
+    {
+        size = (size + GPU_ARENA_ALIGNMENT - 1) / GPU_ARENA_ALIGNMENT * GPU_ARENA_ALIGNMENT;
+        if (size > arenaBytes) {
+            AllocationFailures++;
+            std::cout << "ERROR::GPU_BUFFER_ARENA::ALLOCATION_TOO_BIG " << size << " bytes" << std::endl;
+            return -1;
+        }
+
+        Allocation allocation;
+        allocation.size = size;
+        int arenaIndex = 0;
+        for (; arenaIndex < (int)arenas.size(); arenaIndex++) {
+            if (arenas[arenaIndex].ranges.Allocate(size, allocation.offset))
+                break;
+        }
+        if (arenaIndex == (int)arenas.size()) {
+            // none had a block big enough, compacting them may make one
+            for (Arena& arena : arenas)
+                arena.defragmentPending = true;
+            addArena();
+            arenas[arenaIndex].ranges.Allocate(size, allocation.offset);
+        }
+        allocation.arena = arenaIndex;
+        allocation.live = true;
+
+        int handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+            allocations[handle] = allocation;
+        }
+        else {
+            handle = (int)allocations.size();
+            allocations.push_back(allocation);
+        }
+        return handle;
+    }
+
+    void Free(int handle)
+    {
+        Allocation& allocation = allocations[handle];
+        arenas[allocation.arena].ranges.Free(allocation.offset, allocation.size);
+        arenas[allocation.arena].defragmentPending = true;
+        allocation.live = false;
+        freeHandles.push_back(handle);
+    }
+
+    // writes the front of an allocation
+    void Upload(int handle, const void* data, size_t bytes)
+    {
+        const Allocation& allocation = allocations[handle];
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arenas[allocation.arena].buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, bytes, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    int ArenaOf(int handle) const { return allocations[handle].arena; }
+    uint32_t OffsetOf(int handle) const { return allocations[handle].offset; }     // in bytes, changes when Defragment moves it
+    uint32_t SizeOf(int handle) const { return allocations[handle].size; }
+
+    int ArenaCount() const { return (int)arenas.size(); }
+    unsigned int Buffer(int arena) const { return arenas[arena].buffer; }
+    uint32_t ArenaBytes() const { return arenaBytes; }
+
+    size_t CapacityBytes() const { return arenas.size() * (size_t)arenaBytes; }
+
+    size_t UsedBytes() const
+    {
+        size_t bytes = 0;
+        for (const Arena& arena : arenas)
+            bytes += arena.ranges.UsedBytes();
+        return bytes;
+    }
+
+    uint32_t LargestFreeBlock() const
+    {
+        uint32_t largest = 0;
+        for (const Arena& arena : arenas)
+            largest = std::max(largest, arena.ranges.LargestFreeBlock());
+        return largest;
+    }
+
+    unsigned int FreeBlockCount() const
+    {
+        unsigned int blocks = 0;
+        for (const Arena& arena : arenas)
+            blocks += arena.ranges.FreeBlockCount();
+        return blocks;
+    }
+
+    // the worst arena's RangeAllocator::Fragmentation
+    float Fragmentation() const
+    {
+        float worst = 0.0f;
+        for (const Arena& arena : arenas)
+            worst = std::max(worst, arena.ranges.Fragmentation());
+        return worst;
+    }
+
+    // moves up to maxBytes of allocations of the most fragmented arena (above GPU_ARENA_DEFRAG_THRESHOLD) into free space further
+    // down, highest allocation first, which leaves the free space at the arena's end in one piece. Returns the bytes moved.
+    // Only arenas that had a Free, or an allocation that did not fit into them, since their last complete pass are looked at,
+    // so a frame where nothing changed costs a loop over the arenas
+    size_t Defragment(size_t maxBytes = GPU_ARENA_DEFRAG_BYTES)
+    {
+        int worst = -1;
+        for (int i = 0; i < (int)arenas.size(); i++) {
+            if (!arenas[i].defragmentPending)
+                continue;
+            float fragmentation = arenas[i].ranges.Fragmentation();
+            if (fragmentation <= GPU_ARENA_DEFRAG_THRESHOLD)
+                arenas[i].defragmentPending = false;
+            else if (worst < 0 || fragmentation > arenas[worst].ranges.Fragmentation())
+                worst = i;
+        }
+        if (worst < 0)
+            return 0;
+
+        std::vector<int> handles;
+        for (int handle = 0; handle < (int)allocations.size(); handle++) {
+            if (allocations[handle].live && allocations[handle].arena == worst)
+                handles.push_back(handle);
+        }
+        std::sort(handles.begin(), handles.end(), [&](int a, int b) { return allocations[a].offset > allocations[b].offset; });
+
+        Arena& arena = arenas[worst];
+        size_t moved = 0;
+        bool finished = true;
+        // source and destination never overlap, the destination was free space, so one buffer can be both
+        glBindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+        for (int handle : handles) {
+            Allocation& allocation = allocations[handle];
+            // the first move of a pass always goes, so an allocation bigger than maxBytes cannot hold the arena up for good
+            if (moved > 0 && moved + allocation.size > maxBytes) {
+                finished = false;
+                break;
+            }
+            uint32_t offset;
+            if (!arena.ranges.AllocateBelow(allocation.size, allocation.offset, offset))
+                continue;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, offset, allocation.size);
+            arena.ranges.Free(allocation.offset, allocation.size);
+            allocation.offset = offset;
+            moved += allocation.size;
+            Moves++;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        BytesMoved += moved;
+        // a pass cut short by maxBytes goes on next call, one that got through every allocation has nothing left to move
+        if (finished)
+            arena.defragmentPending = false;
+        return moved;
+    }
+
+private:
+    struct Arena {
+        unsigned int buffer = 0;
+        RangeAllocator ranges;
+        bool defragmentPending = false;     // see Defragment
+    };
+
+    struct Allocation {
+        int arena = 0;
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        bool live = false;
+    };
+
+    uint32_t arenaBytes;
+    std::vector<Arena> arenas;
+    std::vector<Allocation> allocations;    // by handle
+    std::vector<int> freeHandles;
+
+    void addArena()
+    {
+        Arena arena;
+        arena.ranges = RangeAllocator(arenaBytes);
+        glGenBuffers(1, &arena.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, arenaBytes, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        arenas.push_back(std::move(arena));
+    }
+};
+
+
+// Streams chunk-mesh-like allocations (1-64 KB) through a RangeAllocator the size of one arena: fills it to about 80%, then
+// frees and allocates at random like chunks being unloaded and loaded, and reports the cost per operation and the
+// fragmentation left behind, before and after compacting it the way GpuBufferArena::Defragment does
+inline void BenchmarkRangeAllocator(int operations)
+{
+    BenchmarkRandom random(1234u);
+    auto randomSize = [&]() { return (1024u + random.Next() % (63u * 1024u)) / GPU_ARENA_ALIGNMENT * GPU_ARENA_ALIGNMENT; };
+
+    RangeAllocator ranges(GPU_ARENA_BYTES);
+    std::vector<std::pair<uint32_t, uint32_t>> live;   // (offset, size)
+    while (ranges.UsedBytes() < GPU_ARENA_BYTES / 10 * 8) {
+        uint32_t size = randomSize(), offset;
+        if (!ranges.Allocate(size, offset))
+            break;
+        live.emplace_back(offset, size);
+    }
+
+    unsigned int failures = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < operations; i++) {
+        size_t victim = random.Next() % live.size();
+        ranges.Free(live[victim].first, live[victim].second);
+        live[victim] = live.back();
+        live.pop_back();
+
+        uint32_t size = randomSize(), offset;
+        if (ranges.Allocate(size, offset))
+            live.emplace_back(offset, size);
+        else
+            failures++;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    float fragmentation = ranges.Fragmentation();
+    unsigned int freeBlocks = ranges.FreeBlockCount();
+
+    // compact, highest allocation first
+    std::sort(live.begin(), live.end(), [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) { return a.first > b.first; });
+    size_t moved = 0;
+    auto compactStart = std::chrono::high_resolution_clock::now();
+    for (auto& allocation : live) {
+        uint32_t offset;
+        if (!ranges.AllocateBelow(allocation.second, allocation.first, offset))
+            continue;
+        ranges.Free(allocation.first, allocation.second);
+        allocation.first = offset;
+        moved += allocation.second;
+    }
+    auto compactEnd = std::chrono::high_resolution_clock::now();
+
+    double ms = BenchmarkMs(start, end);
+    std::cout << "BENCHMARK::RANGE_ALLOCATOR " << operations << " free + allocate pairs, " << live.size() << " live allocations in "
+        << GPU_ARENA_BYTES / (1024 * 1024) << " MB" << std::endl;
+    std::cout << "  " << ms * 1e6 / operations << " ns per pair, " << failures << " failed allocations" << std::endl;
+    std::cout << "  fragmentation " << fragmentation << " (" << freeBlocks << " free blocks), after compaction " << ranges.Fragmentation()
+        << " (" << ranges.FreeBlockCount() << " free blocks, " << moved / (1024.0 * 1024.0) << " MB moved in "
+        << BenchmarkMs(compactStart, compactEnd) << " ms)" << std::endl;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef INPUT_LATCH_H
+#define INPUT_LATCH_H
+
+#include <algorithm>
+
+#include "Camera.h"
+
+
+// Collects mouse deltas from the cursor callback without touching the camera, so they can be applied as late as possible in the
+// frame (right before the camera matrices are uploaded) instead of before the frame is built. Also measures how long input waits
+// before it is latched into a frame and before that frame is swapped to the screen.
+class InputLatch
+{
+public:
+    // latency statistics in seconds since the last ResetStats
+    double TotalLatchLatency = 0.0;
+    double TotalSwapLatency = 0.0;
+    double MaxSwapLatency = 0.0;
+    unsigned int LatchedFrames = 0;
+
+    // called from the cursor callback with the offsets already in camera convention (y up) and the time the event arrived
+    void AddMouseDelta(float xOffset, float yOffset, double time)
+    {
+        pendingX += xOffset;
+        pendingY += yOffset;
+        if (!hasPending) {
+            oldestPending = time;
+            hasPending = true;
+        }
+    }
+
+    // applies everything accumulated so far to the camera. Returns false if there was nothing to apply
+    bool Latch(Camera& camera, double time)
+    {
+        if (!hasPending)
+            return false;
+
+        camera.ProcessMouseMovement(pendingX, pendingY);
+        pendingX = 0.0f;
+        pendingY = 0.0f;
+        hasPending = false;
+
+        latchedInputTime = oldestPending;
+        latchedThisFrame = true;
+        TotalLatchLatency += time - oldestPending;
+        return true;
+    }
+
+    // called right after glfwSwapBuffers, closes the measurement for input latched into this frame
+    void OnSwap(double time)
+    {
+        if (!latchedThisFrame)
+            return;
+
+        double latency = time - latchedInputTime;
+        TotalSwapLatency += latency;
+        MaxSwapLatency = std::max(MaxSwapLatency, latency);
+        LatchedFrames++;
+        latchedThisFrame = false;
+    }
+
+    void ResetStats()
+    {
+        TotalLatchLatency = 0.0;
+        TotalSwapLatency = 0.0;
+        MaxSwapLatency = 0.0;
+        LatchedFrames = 0;
+    }
+
+private:
+    float pendingX = 0.0f;
+    float pendingY = 0.0f;
+    bool hasPending = false;
+    double oldestPending = 0.0;
+
+    double latchedInputTime = 0.0;
+    bool latchedThisFrame = false;
+};
+
+#endif
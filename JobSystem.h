@@ -0,0 +1,165 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Pool of worker threads shared by everything that wants to run on more than one core.
+// Submit queues fire-and-forget jobs; ParallelFor splits an index range into chunks that the workers and the calling thread
+// pull from a shared counter, and returns once every chunk ran.
+class JobSystem
+{
+public:
+    // one worker per core, leaving one for the render thread
+    static unsigned int DefaultWorkerCount()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+    JobSystem(unsigned int workerCount = DefaultWorkerCount())
+    {
+        for (unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int WorkerCount() const { return (unsigned int)workers.size(); }
+
+    // runs job on some worker later. Without workers it runs right away
+    void Submit(std::function<void()> job)
+    {
+        if (workers.empty()) {
+            job();
+            return;
+        }
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(job));
+        }
+        queueReady.notify_one();
+    }
+
+    // number of submitted jobs that haven't finished yet
+    unsigned int Pending() const { return pending; }
+
+    // blocks until every submitted job finished, running queued jobs on this thread meanwhile
+    void WaitIdle()
+    {
+        while (pending > 0) {
+            if (!runOne())
+                std::this_thread::yield();
+        }
+    }
+
+    // calls body(begin, end) for consecutive chunks of at most grain indices covering [0, count), spread over the workers and
+    // this thread. Chunks run in no particular order
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        if (workers.empty() || chunks == 1) {
+            body(0, count);
+            return;
+        }
+
+        // helpers that only get scheduled after everything is done must still find valid state, so it's shared, not on this stack
+        std::shared_ptr<ParallelForState> state(new ParallelForState());
+        state->count = count;
+        state->grain = grain;
+        state->chunks = chunks;
+        state->body = &body;
+
+        size_t helpers = std::min<size_t>(chunks - 1, workers.size());
+        for (size_t i = 0; i < helpers; i++)
+            Submit([state]() { state->work(); });
+
+        state->work();
+        while (state->done < chunks)
+            std::this_thread::yield();
+    }
+
+private:
+    struct ParallelForState {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        size_t count = 0;
+        size_t grain = 0;
+        size_t chunks = 0;
+        const std::function<void(size_t, size_t)>* body = nullptr;
+
+        void work()
+        {
+            for (size_t chunk = next++; chunk < chunks; chunk = next++) {
+                size_t begin = chunk * grain;
+                (*body)(begin, std::min(count, begin + grain));
+                done++;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<std::function<void()>> queue;
+    std::atomic<unsigned int> pending{ 0 };
+    bool stopping = false;
+
+    bool runOne()
+    {
+        std::function<void()> job;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (queue.empty())
+                return false;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+        pending--;
+        return true;
+    }
+
+    void workerLoop()
+    {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping && queue.empty())
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+            pending--;
+        }
+    }
+};
+
+#endif
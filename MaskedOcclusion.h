@@ -0,0 +1,431 @@
+#ifndef MASKED_OCCLUSION_H
+#define MASKED_OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Benchmark.h"
+#include "Camera.h"
+#include "JobSystem.h"
+
+// Default masked occlusion values
+const int MOC_TILE_WIDTH = 8;       // a tile is 8x4 pixels, one bit each in a 32 bit coverage mask
+const int MOC_TILE_HEIGHT = 4;
+const int MOC_WIDTH = 320;          // occlusion buffer resolution, independent of the window
+const int MOC_HEIGHT = 192;
+const int MOC_BAND_TILE_ROWS = 4;   // tile rows rasterized per job
+const float MOC_MIN_W = 1e-4f;      // clip w below which geometry counts as crossing the camera plane
+
+// Result of testing a box against the occlusion buffer
+enum Occlusion_Result {
+    OCCLUSION_VISIBLE,
+    OCCLUSION_OCCLUDED,
+    OCCLUSION_VIEW_CULLED
+};
+
+
+// CPU occlusion culling in the style of masked software occlusion culling (Hasselgren et al.): occluder triangles are rasterized
+// into a small depth buffer that stores no per-pixel depth. Each 8x4 tile keeps
+//  - zMax0, a far bound for every pixel of the tile (the reference layer),
+//  - a coverage mask and zMax1, a far bound for just the masked pixels (the working layer).
+// Triangles add their coverage to the working layer; once it covers the whole tile it replaces the reference layer. Bounds only
+// ever move closer, so a box whose nearest depth is behind them is certainly hidden.
+//
+// Coverage is computed 8 pixels (one tile row) at a time with AVX2 where available, and the screen is split into bands of tile
+// rows that are rasterized on the job system's workers. Depth is OpenGL window depth: 0 near, 1 far.
+class MaskedOcclusion
+{
+public:
+    // statistics of the last RenderOccluders / TestBoxes
+    unsigned int TrianglesRasterized = 0;
+    unsigned int BoxesVisible = 0;
+    unsigned int BoxesOccluded = 0;
+    unsigned int BoxesViewCulled = 0;
+
+    MaskedOcclusion(int width = MOC_WIDTH, int height = MOC_HEIGHT)
+    {
+        SetResolution(width, height);
+    }
+
+    // rounded up to whole tiles
+    void SetResolution(int width, int height)
+    {
+        tilesX = std::max(1, (width + MOC_TILE_WIDTH - 1) / MOC_TILE_WIDTH);
+        tilesY = std::max(1, (height + MOC_TILE_HEIGHT - 1) / MOC_TILE_HEIGHT);
+        this->width = tilesX * MOC_TILE_WIDTH;
+        this->height = tilesY * MOC_TILE_HEIGHT;
+        mask.resize((size_t)tilesX * tilesY);
+        zMax0.resize(mask.size());
+        zMax1.resize(mask.size());
+        Clear();
+    }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    void Clear()
+    {
+        std::fill(mask.begin(), mask.end(), 0u);
+        std::fill(zMax0.begin(), zMax0.end(), 1.0f);
+        std::fill(zMax1.begin(), zMax1.end(), 0.0f);
+    }
+
+    // appends the 12 triangles of a box to triangles, for use as an occluder
+    static void AppendBoxTriangles(std::vector<glm::vec3>& triangles, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        static const int faces[6][4] = {
+            { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 }
+        };
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; i++)
+            corners[i] = glm::vec3(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z);
+        for (const int* face : faces) {
+            triangles.insert(triangles.end(), { corners[face[0]], corners[face[1]], corners[face[2]] });
+            triangles.insert(triangles.end(), { corners[face[0]], corners[face[2]], corners[face[3]] });
+        }
+    }
+
+    // rasterizes world space occluder triangles (3 vertices each). Triangles crossing the camera plane are skipped, which only
+    // makes the result less aggressive. jobs may be null to rasterize on this thread
+    void RenderOccluders(const glm::mat4& viewProjection, const std::vector<glm::vec3>& triangles, JobSystem* jobs = nullptr)
+    {
+        setupTriangles(viewProjection, triangles);
+        TrianglesRasterized = (unsigned int)setup.size();
+
+        int bands = (tilesY + MOC_BAND_TILE_ROWS - 1) / MOC_BAND_TILE_ROWS;
+        auto rasterizeBands = [this](size_t begin, size_t end) {
+            for (size_t band = begin; band < end; band++)
+                rasterizeBand((int)band * MOC_BAND_TILE_ROWS, std::min(tilesY, ((int)band + 1) * MOC_BAND_TILE_ROWS));
+        };
+        if (jobs)
+            jobs->ParallelFor(bands, 1, rasterizeBands);
+        else
+            rasterizeBands(0, bands);
+    }
+
+    Occlusion_Result TestBox(const glm::mat4& viewProjection, const glm::vec3& boxMin, const glm::vec3& boxMax) const
+    {
+        glm::vec4 clip[8];
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z);
+            clip[i] = viewProjection * glm::vec4(corner, 1.0f);
+        }
+
+        // outside one clip plane with all corners
+        for (int axis = 0; axis < 3; axis++) {
+            bool allBelow = true, allAbove = true;
+            for (const glm::vec4& c : clip) {
+                allBelow = allBelow && c[axis] < -c.w;
+                allAbove = allAbove && c[axis] > c.w;
+            }
+            if (allBelow || allAbove)
+                return OCCLUSION_VIEW_CULLED;
+        }
+
+        float minX = (float)width, minY = (float)height, maxX = 0.0f, maxY = 0.0f, zMin = 1.0f;
+        for (const glm::vec4& c : clip) {
+            if (c.w < MOC_MIN_W)
+                return OCCLUSION_VISIBLE;  // reaches behind the camera, the projection is unbounded
+            glm::vec3 window = toWindow(c);
+            minX = std::min(minX, window.x);
+            maxX = std::max(maxX, window.x);
+            minY = std::min(minY, window.y);
+            maxY = std::max(maxY, window.y);
+            zMin = std::min(zMin, window.z);
+        }
+        zMin = std::max(zMin, 0.0f);
+
+        // every pixel whose center the box could touch
+        int x0 = std::max(0, (int)std::floor(minX - 0.5f));
+        int x1 = std::min(width - 1, (int)std::ceil(maxX - 0.5f));
+        int y0 = std::max(0, (int)std::floor(minY - 0.5f));
+        int y1 = std::min(height - 1, (int)std::ceil(maxY - 0.5f));
+        if (x0 > x1 || y0 > y1)
+            return OCCLUSION_VIEW_CULLED;
+
+        for (int ty = y0 / MOC_TILE_HEIGHT; ty <= y1 / MOC_TILE_HEIGHT; ty++) {
+            uint32_t rowBits = 0;
+            for (int row = 0; row < MOC_TILE_HEIGHT; row++) {
+                int y = ty * MOC_TILE_HEIGHT + row;
+                if (y >= y0 && y <= y1)
+                    rowBits |= 0xFFu << (row * MOC_TILE_WIDTH);
+            }
+
+            for (int tx = x0 / MOC_TILE_WIDTH; tx <= x1 / MOC_TILE_WIDTH; tx++) {
+                int first = std::max(x0 - tx * MOC_TILE_WIDTH, 0);
+                int last = std::min(x1 - tx * MOC_TILE_WIDTH, MOC_TILE_WIDTH - 1);
+                uint32_t columnBits = ((0xFFu >> (MOC_TILE_WIDTH - 1 - last)) & (0xFFu << first)) * 0x01010101u;
+                uint32_t boxMask = rowBits & columnBits;
+
+                size_t tile = (size_t)ty * tilesX + tx;
+                if (zMin < zMax0[tile]) {
+                    // in front of the reference layer: hidden only where the working layer covers it and is closer still
+                    if ((boxMask & ~mask[tile]) != 0 || zMin < zMax1[tile])
+                        return OCCLUSION_VISIBLE;
+                }
+            }
+        }
+        return OCCLUSION_OCCLUDED;
+    }
+
+    // tests count boxes, writing 1 for every box that has to be drawn into visible. jobs may be null to test on this thread
+    void TestBoxes(const glm::mat4& viewProjection, const glm::vec3* boxMins, const glm::vec3* boxMaxs, size_t count, std::vector<uint8_t>& visible, JobSystem* jobs = nullptr)
+    {
+        visible.resize(count);
+        std::atomic<unsigned int> counts[3];
+        for (std::atomic<unsigned int>& c : counts)
+            c = 0;
+
+        auto testRange = [&](size_t begin, size_t end) {
+            unsigned int local[3] = {};
+            for (size_t i = begin; i < end; i++) {
+                Occlusion_Result result = TestBox(viewProjection, boxMins[i], boxMaxs[i]);
+                visible[i] = result == OCCLUSION_VISIBLE;
+                local[result]++;
+            }
+            for (int r = 0; r < 3; r++)
+                counts[r] += local[r];
+        };
+        if (jobs)
+            jobs->ParallelFor(count, 1024, testRange);
+        else
+            testRange(0, count);
+
+        BoxesVisible = counts[OCCLUSION_VISIBLE];
+        BoxesOccluded = counts[OCCLUSION_OCCLUDED];
+        BoxesViewCulled = counts[OCCLUSION_VIEW_CULLED];
+    }
+
+private:
+    // a triangle ready for rasterizing: edge functions A*x + B*y + C, non-negative inside, and its bounds in tiles
+    struct SetupTriangle {
+        float a[3], b[3], c[3];
+        float zMax;
+        int tileMinX, tileMinY, tileMaxX, tileMaxY;
+    };
+
+    int width = 0, height = 0;
+    int tilesX = 0, tilesY = 0;
+    std::vector<uint32_t> mask;
+    std::vector<float> zMax0;
+    std::vector<float> zMax1;
+    std::vector<SetupTriangle> setup;
+
+    glm::vec3 toWindow(const glm::vec4& clip) const
+    {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+    }
+
+    void setupTriangles(const glm::mat4& viewProjection, const std::vector<glm::vec3>& triangles)
+    {
+        setup.clear();
+        for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+            glm::vec4 clip[3];
+            bool behind = false;
+            for (int v = 0; v < 3; v++) {
+                clip[v] = viewProjection * glm::vec4(triangles[t + v], 1.0f);
+                behind = behind || clip[v].w < MOC_MIN_W;
+            }
+            if (behind)
+                continue;
+
+            glm::vec3 p[3] = { toWindow(clip[0]), toWindow(clip[1]), toWindow(clip[2]) };
+            float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+            if (std::fabs(area) < 1e-6f)
+                continue;
+            if (area < 0.0f)
+                std::swap(p[1], p[2]);  // both windings are occluders, make them counter clockwise
+
+            float minX = std::min({ p[0].x, p[1].x, p[2].x }), maxX = std::max({ p[0].x, p[1].x, p[2].x });
+            float minY = std::min({ p[0].y, p[1].y, p[2].y }), maxY = std::max({ p[0].y, p[1].y, p[2].y });
+            if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+                continue;
+
+            SetupTriangle tri;
+            for (int e = 0; e < 3; e++) {
+                const glm::vec3& from = p[e];
+                const glm::vec3& to = p[(e + 1) % 3];
+                tri.a[e] = from.y - to.y;
+                tri.b[e] = to.x - from.x;
+                tri.c[e] = -(tri.a[e] * from.x + tri.b[e] * from.y);
+            }
+            // depth is linear across the triangle in window space, so the farthest vertex bounds all of it
+            tri.zMax = std::min(std::max({ p[0].z, p[1].z, p[2].z }), 1.0f);
+            if (std::min({ p[0].z, p[1].z, p[2].z }) > 1.0f)
+                continue;
+            tri.tileMinX = std::max(0, (int)minX / MOC_TILE_WIDTH);
+            tri.tileMaxX = std::min(tilesX - 1, (int)maxX / MOC_TILE_WIDTH);
+            tri.tileMinY = std::max(0, (int)minY / MOC_TILE_HEIGHT);
+            tri.tileMaxY = std::min(tilesY - 1, (int)maxY / MOC_TILE_HEIGHT);
+            setup.push_back(tri);
+        }
+    }
+
+    // every triangle, clipped to tile rows [rowBegin, rowEnd). Bands touch disjoint tiles, so they run in parallel unlocked
+    void rasterizeBand(int rowBegin, int rowEnd)
+    {
+        for (const SetupTriangle& tri : setup) {
+            int ty0 = std::max(tri.tileMinY, rowBegin);
+            int ty1 = std::min(tri.tileMaxY, rowEnd - 1);
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tri.tileMinX; tx <= tri.tileMaxX; tx++) {
+                    uint32_t coverage = tileCoverage(tri, tx, ty);
+                    if (coverage)
+                        updateTile((size_t)ty * tilesX + tx, coverage, tri.zMax);
+                }
+            }
+        }
+    }
+
+    // bit row * 8 + column is set where the pixel center is inside all three edges. Centers exactly on an edge count for both
+    // triangles sharing it, otherwise tiles along a diagonal never fill up
+    static uint32_t tileCoverageScalar(const SetupTriangle& tri, int tileX, int tileY)
+    {
+        uint32_t coverage = 0;
+        for (int row = 0; row < MOC_TILE_HEIGHT; row++) {
+            float y = (float)(tileY * MOC_TILE_HEIGHT + row) + 0.5f;
+            for (int column = 0; column < MOC_TILE_WIDTH; column++) {
+                float x = (float)(tileX * MOC_TILE_WIDTH + column) + 0.5f;
+                bool inside = true;
+                for (int e = 0; e < 3; e++)
+                    inside = inside && tri.a[e] * x + tri.b[e] * y + tri.c[e] >= 0.0f;
+                if (inside)
+                    coverage |= 1u << (row * MOC_TILE_WIDTH + column);
+            }
+        }
+        return coverage;
+    }
+
+#if defined(__AVX2__)
+    // one tile row per iteration, the 8 pixels of the row in the 8 lanes
+    static uint32_t tileCoverage(const SetupTriangle& tri, int tileX, int tileY)
+    {
+        const __m256 columnOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        __m256 x = _mm256_add_ps(_mm256_set1_ps((float)(tileX * MOC_TILE_WIDTH)), columnOffsets);
+        __m256 zero = _mm256_setzero_ps();
+
+        __m256 edgeX[3];
+        for (int e = 0; e < 3; e++)
+            edgeX[e] = _mm256_mul_ps(_mm256_set1_ps(tri.a[e]), x);
+
+        uint32_t coverage = 0;
+        for (int row = 0; row < MOC_TILE_HEIGHT; row++) {
+            float y = (float)(tileY * MOC_TILE_HEIGHT + row) + 0.5f;
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int e = 0; e < 3; e++) {
+                __m256 edge = _mm256_add_ps(edgeX[e], _mm256_set1_ps(tri.b[e] * y + tri.c[e]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, zero, _CMP_GE_OQ));
+            }
+            coverage |= (uint32_t)_mm256_movemask_ps(inside) << (row * MOC_TILE_WIDTH);
+        }
+        return coverage;
+    }
+#else
+    static uint32_t tileCoverage(const SetupTriangle& tri, int tileX, int tileY)
+    {
+        return tileCoverageScalar(tri, tileX, tileY);
+    }
+#endif
+
+    void updateTile(size_t tile, uint32_t coverage, float zTriangle)
+    {
+        // entirely behind what the tile already guarantees, adds nothing
+        if (zTriangle >= zMax0[tile])
+            return;
+
+        mask[tile] |= coverage;
+        zMax1[tile] = std::max(zMax1[tile], zTriangle);
+
+        // the working layer covers the whole tile: it becomes the new (closer) reference layer
+        if (mask[tile] == 0xFFFFFFFFu) {
+            zMax0[tile] = zMax1[tile];
+            zMax1[tile] = 0.0f;
+            mask[tile] = 0;
+        }
+    }
+};
+
+
+// Culls a field of small boxes behind a few large occluders, frustum only against frustum + masked occlusion, and prints both
+inline void BenchmarkOcclusionCulling(JobSystem& jobs, size_t objectCount, int iterations)
+{
+    Camera camera(glm::vec3(0.0f, 1.7f, 0.0f));
+    camera.SetAspectRatio(16.0f / 9.0f);
+    camera.SetClipPlanes(0.1f, 500.0f);
+    const glm::mat4& viewProjection = camera.GetViewProjectionMatrix();
+
+    // a street of buildings in front of the camera
+    std::vector<glm::vec3> occluders;
+    for (int i = 0; i < 16; i++) {
+        float x = -60.0f + 8.0f * i;
+        float height = 6.0f + (float)((i * 7) % 5) * 4.0f;
+        MaskedOcclusion::AppendBoxTriangles(occluders, glm::vec3(x, 0.0f, -24.0f), glm::vec3(x + 7.0f, height, -18.0f));
+    }
+
+    // small objects scattered behind and around them
+    std::vector<glm::vec3> mins(objectCount), maxs(objectCount);
+    BenchmarkRandom random(12345u);
+    for (size_t i = 0; i < objectCount; i++) {
+        glm::vec3 center(-150.0f + 300.0f * random.NextFloat(), 2.0f * random.NextFloat(), -300.0f * random.NextFloat());
+        mins[i] = center - glm::vec3(0.5f);
+        maxs[i] = center + glm::vec3(0.5f);
+    }
+
+    MaskedOcclusion occlusion;
+    std::vector<uint8_t> visible;
+    size_t frustumVisible = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        frustumVisible = 0;
+        for (size_t i = 0; i < objectCount; i++)
+            frustumVisible += camera.IsBoxInFrustum(mins[i], maxs[i]);
+    }
+    auto frustumEnd = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        occlusion.Clear();
+        occlusion.RenderOccluders(viewProjection, occluders);
+        occlusion.TestBoxes(viewProjection, mins.data(), maxs.data(), objectCount, visible);
+    }
+    auto serialEnd = std::chrono::high_resolution_clock::now();
+
+    double rasterMs = 0.0;
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        auto rasterStart = std::chrono::high_resolution_clock::now();
+        occlusion.Clear();
+        occlusion.RenderOccluders(viewProjection, occluders, &jobs);
+        rasterMs += BenchmarkMs(rasterStart, std::chrono::high_resolution_clock::now());
+        occlusion.TestBoxes(viewProjection, mins.data(), maxs.data(), objectCount, visible, &jobs);
+    }
+    auto parallelEnd = std::chrono::high_resolution_clock::now();
+
+    double frustumMs = BenchmarkMs(start, frustumEnd) / iterations;
+    double serialMs = BenchmarkMs(frustumEnd, serialEnd) / iterations;
+    double parallelMs = BenchmarkMs(serialEnd, parallelEnd) / iterations;
+#if defined(__AVX2__)
+    const char* path = "AVX2";
+#else
+    const char* path = "scalar";
+#endif
+    std::cout << "BENCHMARK::OCCLUSION_CULLING " << objectCount << " objects, " << occlusion.TrianglesRasterized << " occluder triangles, "
+        << occlusion.Width() << "x" << occlusion.Height() << " buffer" << std::endl;
+    std::cout << "  frustum only: " << frustumMs << " ms, " << frustumVisible << " draws" << std::endl;
+    std::cout << "  masked occlusion (" << path << ", 1 thread): " << serialMs << " ms" << std::endl;
+    std::cout << "  masked occlusion (" << path << ", " << jobs.WorkerCount() + 1 << " threads): " << parallelMs << " ms (" << rasterMs / iterations
+        << " ms rasterizing), " << occlusion.BoxesVisible << " draws, " << occlusion.BoxesOccluded << " occluded" << std::endl;
+}
+
+#endif
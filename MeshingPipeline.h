@@ -0,0 +1,284 @@
+#ifndef MESHING_PIPELINE_H
+#define MESHING_PIPELINE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Benchmark.h"
+#include "ChunkMesher.h"
+#include "JobSystem.h"
+#include "MpscQueue.h"
+#include "VoxelChunk.h"
+
+// Default meshing pipeline values
+const unsigned int MESHING_MAX_IN_FLIGHT = 256;     // meshing jobs submitted but not yet collected by Poll, also the queue size
+const unsigned int MESHING_MISSING_NEIGHBOR = 0xFFFFFFFFu;
+
+
+// A mesh finished on a worker thread, ready for upload
+struct MeshedChunk {
+    glm::ivec3 Position = glm::ivec3(0);
+    ChunkMesh Mesh;
+    Voxel_Mesh_Format Format = VOXEL_PACKED_VERTICES;
+    std::vector<uint32_t> Vertices; // Mesh packed in Format, ready for glBufferData
+    unsigned int Ticket = 0;        // which request produced it
+};
+
+
+// Moves chunk meshing off the GL thread. Request snapshots a chunk with its neighbor border right away (the world is only
+// ever touched on the calling thread), a JobSystem worker meshes the snapshot, and the result comes back through a lock-free
+// queue that Poll drains on the GL thread.
+// A chunk has at most one job in flight. Requests arriving meanwhile only replace the chunk's waiting snapshot, so a chunk
+// edited every frame is meshed as often as the workers keep up, not once per edit, and a mesh finishing after a newer
+// request for its chunk is thrown away instead of uploaded. Requests for a chunk whose blocks and neighbors haven't changed
+// since the last one are dropped outright.
+class MeshingPipeline
+{
+public:
+    // cumulative statistics
+    unsigned int JobsSubmitted = 0;
+    unsigned int RequestsMerged = 0;        // requests dropped or folded into a newer one before any job started on them
+    unsigned int ResultsDiscarded = 0;      // meshes that finished after their chunk was requested again or cancelled
+    unsigned int MeshesDelivered = 0;
+
+    MeshingPipeline(JobSystem& jobs, Voxel_Mesh_Format format = VOXEL_PACKED_VERTICES) : jobs(jobs), completed(MESHING_MAX_IN_FLIGHT), format(format)
+    {
+    }
+
+    ~MeshingPipeline()
+    {
+        for (auto& entry : entries)
+            delete entry.second.pending;
+        // the jobs still running write to the queue, so they have to be collected before it goes away
+        while (inFlight > 0) {
+            MeshedChunk* result;
+            if (completed.TryPop(result)) {
+                delete result;
+                inFlight--;
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    MeshingPipeline(const MeshingPipeline&) = delete;
+    MeshingPipeline& operator=(const MeshingPipeline&) = delete;
+
+    Voxel_Mesh_Format Format() const { return format; }
+
+    // meshes of later requests come packed in the new format, jobs already submitted keep the old one
+    void SetFormat(Voxel_Mesh_Format newFormat) { format = newFormat; }
+
+    // chunks requested but not delivered or discarded yet
+    unsigned int Pending() const { return inFlight + (unsigned int)waiting.size(); }
+
+    // neighbors are indexed by Voxel_Face and may be null
+    void Request(const Chunk& chunk, const Chunk* const neighbors[6])
+    {
+        Entry& entry = entries[chunk.Position];
+        unsigned int versions[7] = { chunk.Version() };
+        for (int i = 0; i < 6; i++)
+            versions[i + 1] = neighbors[i] ? neighbors[i]->Version() : MESHING_MISSING_NEIGHBOR;
+        if (entry.requested && std::equal(versions, versions + 7, entry.versions)) {
+            RequestsMerged++;
+            return;
+        }
+        std::copy(versions, versions + 7, entry.versions);
+        entry.requested = true;
+        entry.ticket = ++lastTicket;
+
+        if (!entry.pending) {
+            entry.pending = new ChunkSnapshot();
+            if (!entry.inFlight)
+                waiting.push_back(chunk.Position);
+        }
+        else {
+            RequestsMerged++;
+        }
+        entry.pending->Capture(chunk, neighbors);
+        entry.pendingTicket = entry.ticket;
+
+        submitWaiting();
+    }
+
+    // forgets a chunk (e.g. unloaded); a job still running for it gets its result discarded
+    void Cancel(const glm::ivec3& position)
+    {
+        auto it = entries.find(position);
+        if (it == entries.end())
+            return;
+        delete it->second.pending;
+        entries.erase(it);
+    }
+
+    // GL thread. Hands every mesh finished since the last call to upload, newest request per chunk only
+    void Poll(const std::function<void(MeshedChunk&)>& upload)
+    {
+        MeshedChunk* result;
+        while (completed.TryPop(result)) {
+            inFlight--;
+            auto it = entries.find(result->Position);
+            if (it == entries.end()) {
+                ResultsDiscarded++;
+                delete result;
+                continue;
+            }
+
+            Entry& entry = it->second;
+            if (entry.inFlight && entry.inFlightTicket == result->Ticket) {
+                entry.inFlight = false;
+                if (entry.pending)
+                    waiting.push_back(result->Position);
+            }
+            if (result->Ticket == entry.ticket) {
+                upload(*result);
+                MeshesDelivered++;
+            }
+            else {
+                ResultsDiscarded++;
+            }
+            delete result;
+        }
+        submitWaiting();
+    }
+
+private:
+    struct Entry {
+        unsigned int versions[7] = {};          // the chunk's and its neighbors' versions at the last request
+        bool requested = false;
+        unsigned int ticket = 0;                // last request
+        ChunkSnapshot* pending = nullptr;       // snapshot of the last request, until its job starts
+        unsigned int pendingTicket = 0;
+        bool inFlight = false;
+        unsigned int inFlightTicket = 0;
+    };
+
+    JobSystem& jobs;
+    MpscQueue<MeshedChunk*> completed;
+    std::unordered_map<glm::ivec3, Entry, ChunkPositionHash> entries;
+    std::deque<glm::ivec3> waiting;             // chunks with a pending snapshot and no job in flight
+    unsigned int inFlight = 0;                  // jobs whose result hasn't been popped yet, never more than the queue holds
+    unsigned int lastTicket = 0;
+    Voxel_Mesh_Format format;
+
+    void submitWaiting()
+    {
+        while (inFlight < MESHING_MAX_IN_FLIGHT && !waiting.empty()) {
+            glm::ivec3 position = waiting.front();
+            waiting.pop_front();
+            auto it = entries.find(position);
+            if (it == entries.end() || !it->second.pending || it->second.inFlight)
+                continue;
+
+            Entry& entry = it->second;
+            ChunkSnapshot* snapshot = entry.pending;
+            unsigned int ticket = entry.pendingTicket;
+            entry.pending = nullptr;
+            entry.inFlight = true;
+            entry.inFlightTicket = ticket;
+            inFlight++;
+            JobsSubmitted++;
+
+            MpscQueue<MeshedChunk*>* queue = &completed;
+            Voxel_Mesh_Format packing = format;
+            jobs.Submit([snapshot, ticket, packing, queue]() {
+                // the mesher's scratch memory is reused by every job on the same worker
+                static thread_local ChunkMesher mesher;
+                MeshedChunk* result = new MeshedChunk();
+                result->Position = snapshot->Position;
+                result->Ticket = ticket;
+                result->Format = packing;
+                mesher.MeshBinary(*snapshot, result->Mesh);
+                result->Mesh.AppendPacked(packing, result->Vertices);
+                delete snapshot;
+                // can't fail, at most MESHING_MAX_IN_FLIGHT results exist at once
+                queue->TryPush(result);
+            });
+        }
+    }
+};
+
+
+// Meshes a grid of test terrain chunks through the pipeline while editing random chunks, some of them several times
+// before their first mesh is done, and reports throughput and how many rebuilds were saved
+inline void BenchmarkMeshingPipeline(JobSystem& jobs, int chunksX, int chunksY, int chunksZ)
+{
+    BenchmarkRandom random(1234u);
+    std::vector<Chunk> chunks;
+    chunks.reserve((size_t)chunksX * chunksY * chunksZ);
+    for (int cy = 0; cy < chunksY; cy++)
+        for (int cz = 0; cz < chunksZ; cz++)
+            for (int cx = 0; cx < chunksX; cx++) {
+                chunks.emplace_back(glm::ivec3(cx, cy, cz));
+                FillTestTerrain(chunks.back(), random);
+            }
+    auto chunkAt = [&](glm::ivec3 p) -> const Chunk* {
+        if (p.x < 0 || p.y < 0 || p.z < 0 || p.x >= chunksX || p.y >= chunksY || p.z >= chunksZ)
+            return nullptr;
+        return &chunks[((size_t)p.y * chunksZ + p.z) * chunksX + p.x];
+    };
+    MeshingPipeline pipeline(jobs);
+    auto request = [&](const Chunk& chunk) {
+        const Chunk* neighbors[6] = {
+            chunkAt(chunk.Position + glm::ivec3(1, 0, 0)), chunkAt(chunk.Position - glm::ivec3(1, 0, 0)),
+            chunkAt(chunk.Position + glm::ivec3(0, 1, 0)), chunkAt(chunk.Position - glm::ivec3(0, 1, 0)),
+            chunkAt(chunk.Position + glm::ivec3(0, 0, 1)), chunkAt(chunk.Position - glm::ivec3(0, 0, 1))
+        };
+        pipeline.Request(chunk, neighbors);
+    };
+
+    size_t quads = 0, vertexBytes = 0;
+    auto upload = [&](MeshedChunk& meshed) {
+        quads += meshed.Mesh.Quads.size();
+        vertexBytes += meshed.Vertices.size() * sizeof(uint32_t);
+    };
+
+    // everything at once, like on load
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const Chunk& chunk : chunks)
+        request(chunk);
+    while (pipeline.Pending() > 0) {
+        pipeline.Poll(upload);
+        std::this_thread::yield();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    unsigned int loadJobs = pipeline.JobsSubmitted;
+
+    // then 100 "frames" of a few edits and a poll each, most jobs still running when their chunk is edited again
+    for (int frame = 0; frame < 100; frame++) {
+        for (int i = 0; i < 8; i++) {
+            unsigned int r = random.Next();
+            Chunk& chunk = chunks[r % (chunks.size() / 8 + 1)];
+            chunk.Set(r & 31, (r >> 5) & 31, (r >> 10) & 31, BLOCK_AIR);
+            request(chunk);
+        }
+        // re-requesting an unchanged chunk costs nothing
+        request(chunks[chunks.size() - 1 - frame % chunks.size()]);
+        pipeline.Poll(upload);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (pipeline.Pending() > 0) {
+        pipeline.Poll(upload);
+        std::this_thread::yield();
+    }
+
+    double ms = BenchmarkMs(start, end);
+    std::cout << "BENCHMARK::MESHING_PIPELINE " << chunks.size() << " chunks, " << jobs.WorkerCount() << " workers" << std::endl;
+    std::cout << "  load: " << loadJobs << " chunks in " << ms << " ms (" << loadJobs / (ms / 1000.0) << " chunks/s, snapshots included)" << std::endl;
+    std::cout << "  edits: " << pipeline.JobsSubmitted - loadJobs << " jobs for 800 edits, " << pipeline.RequestsMerged << " requests merged, "
+        << pipeline.ResultsDiscarded << " stale results discarded" << std::endl;
+    std::cout << "  " << pipeline.MeshesDelivered << " meshes delivered, " << quads << " quads, " << vertexBytes / (1024.0 * 1024.0)
+        << " MB of packed vertices (" << quads * 6 * 5 * sizeof(float) / (1024.0 * 1024.0) << " MB as 6 five float vertices per quad, "
+        << quads * 2 * sizeof(uint32_t) / (1024.0 * 1024.0) << " MB as pulled faces)" << std::endl;
+}
+
+#endif
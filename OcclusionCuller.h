@@ -0,0 +1,238 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "Camera.h"
+#include "Shader.h"
+
+// Default occlusion culling values
+const int OCCLUSION_QUERIES_PER_OBJECT = 3;    // queries in flight per object, results are read a few frames late so nothing stalls
+
+
+// Culls draws hidden behind other geometry with hardware occlusion queries (GL_ANY_SAMPLES_PASSED) and conditional rendering,
+// both core in GL 3.3. Every frame, for the objects inside the frustum:
+//  1. objects that were visible at the last known result are drawn straight away, each draw wrapped in a query so it is noticed
+//     when they become hidden. They fill the depth buffer first and act as the occluders,
+//  2. objects that were hidden get their bounding box drawn (no color or depth writes) inside a query,
+//  3. and their real draw is issued with glBeginConditionalRender(GL_QUERY_NO_WAIT) on that query: the GPU drops it when no
+//     sample of the box passed, and draws anyway if the result isn't ready in time, so the CPU never waits for it.
+// Query results are only read back once available and only decide which of the two paths an object takes in later frames.
+class OcclusionCuller
+{
+public:
+    // statistics of the last Render
+    unsigned int FrustumCulled = 0;
+    unsigned int DrawsIssued = 0;       // unconditional draws
+    unsigned int BoxesTested = 0;       // bounding box queries, each followed by a conditional draw
+    // conditional draws the GPU skipped, counted when their query result arrives (so a frame or two late)
+    unsigned int DrawsSkipped = 0;
+
+    // boxShader draws boxMin/boxMax with the Matrices uniform block, e.g. boundingBox.vs with depthOnly.fs
+    OcclusionCuller(Shader& boxShader) : boxShader(boxShader)
+    {
+        // unit cube for the boxes, positions only
+        float corners[] = {
+            -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f
+        };
+        unsigned int indices[] = {
+            0, 2, 1, 0, 3, 2,   4, 5, 6, 4, 6, 7,   0, 4, 7, 0, 7, 3,
+            1, 2, 6, 1, 6, 5,   0, 1, 5, 0, 5, 4,   3, 7, 6, 3, 6, 2
+        };
+
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &boxVBO);
+        glGenBuffers(1, &boxEBO);
+        glBindVertexArray(boxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+    }
+
+    ~OcclusionCuller()
+    {
+        for (Object& object : objects)
+            glDeleteQueries(OCCLUSION_QUERIES_PER_OBJECT, object.queries);
+        glDeleteVertexArrays(1, &boxVAO);
+        glDeleteBuffers(1, &boxVBO);
+        glDeleteBuffers(1, &boxEBO);
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // registers an object by its world space bounds, returns its index
+    unsigned int Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        Object object;
+        object.boundsMin = boundsMin;
+        object.boundsMax = boundsMax;
+        glGenQueries(OCCLUSION_QUERIES_PER_OBJECT, object.queries);
+        objects.push_back(object);
+        return (unsigned int)objects.size() - 1;
+    }
+
+    void SetBounds(unsigned int index, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        objects[index].boundsMin = boundsMin;
+        objects[index].boundsMax = boundsMax;
+    }
+
+    void ResetStats()
+    {
+        DrawsSkipped = 0;
+    }
+
+    // last known visibility of an object
+    bool IsVisible(unsigned int index) const { return objects[index].visible; }
+
+    // draws the objects listed in order (e.g. sorted front to back). prepareDraw binds whatever drawObject needs and is called
+    // again after the boxes, since they switch program and vertex array
+    void Render(const Camera& camera, const std::vector<unsigned int>& order, const std::function<void()>& prepareDraw, const std::function<void(unsigned int)>& drawObject)
+    {
+        FrustumCulled = 0;
+        DrawsIssued = 0;
+        BoxesTested = 0;
+
+        collectResults();
+
+        tested.clear();
+        prepareDraw();
+        for (unsigned int index : order) {
+            Object& object = objects[index];
+            if (!camera.IsBoxInFrustum(object.boundsMin, object.boundsMax)) {
+                FrustumCulled++;
+                continue;
+            }
+
+            // from inside the box its faces get clipped away and the test would fail, so it's visible by definition
+            glm::vec3 margin(camera.NearPlane * 2.0f);
+            bool cameraInside = glm::all(glm::greaterThanEqual(camera.Position, object.boundsMin - margin))
+                && glm::all(glm::lessThanEqual(camera.Position, object.boundsMax + margin));
+            if (cameraInside)
+                object.visible = true;
+
+            if (object.visible) {
+                int slot = beginQuery(object, false);
+                drawObject(index);
+                if (slot >= 0)
+                    glEndQuery(GL_ANY_SAMPLES_PASSED);
+                DrawsIssued++;
+            }
+            else {
+                tested.push_back(index);
+            }
+        }
+
+        if (tested.empty())
+            return;
+
+        // the boxes only probe the depth buffer, they must not change it
+        GLint depthFunc;
+        GLboolean depthMask;
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LESS);
+
+        boxShader.use();
+        glBindVertexArray(boxVAO);
+        testedQueries.clear();
+        for (unsigned int index : tested) {
+            Object& object = objects[index];
+            int slot = beginQuery(object, true);
+            if (slot >= 0) {
+                boxShader.setVec3("boxMin", object.boundsMin);
+                boxShader.setVec3("boxMax", object.boundsMax);
+                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                glEndQuery(GL_ANY_SAMPLES_PASSED);
+                BoxesTested++;
+            }
+            testedQueries.push_back(slot >= 0 ? object.queries[slot] : 0);
+        }
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(depthMask);
+        glDepthFunc(depthFunc);
+
+        prepareDraw();
+        for (size_t i = 0; i < tested.size(); i++) {
+            // no free query this frame (the GPU is far behind), just draw it
+            if (testedQueries[i] == 0) {
+                drawObject(tested[i]);
+                DrawsIssued++;
+                continue;
+            }
+            glBeginConditionalRender(testedQueries[i], GL_QUERY_NO_WAIT);
+            drawObject(tested[i]);
+            glEndConditionalRender();
+        }
+    }
+
+private:
+    struct Object {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        bool visible = true;    // nothing is known before the first result, so draw it
+        unsigned int queries[OCCLUSION_QUERIES_PER_OBJECT];
+        bool pending[OCCLUSION_QUERIES_PER_OBJECT] = {};
+        bool conditional[OCCLUSION_QUERIES_PER_OBJECT] = {};   // the query guarded a conditional draw
+        int next = 0;
+    };
+
+    Shader& boxShader;
+    unsigned int boxVAO, boxVBO, boxEBO;
+    std::vector<Object> objects;
+    std::vector<unsigned int> tested;
+    std::vector<unsigned int> testedQueries;
+
+    // starts a query in the object's next slot, -1 if that slot's previous result hasn't been read yet
+    int beginQuery(Object& object, bool conditional)
+    {
+        int slot = object.next;
+        if (object.pending[slot])
+            return -1;
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, object.queries[slot]);
+        object.pending[slot] = true;
+        object.conditional[slot] = conditional;
+        object.next = (slot + 1) % OCCLUSION_QUERIES_PER_OBJECT;
+        return slot;
+    }
+
+    // reads every available result, oldest first, and keeps the newest as the object's visibility
+    void collectResults()
+    {
+        for (Object& object : objects) {
+            for (int i = 0; i < OCCLUSION_QUERIES_PER_OBJECT; i++) {
+                int slot = (object.next + i) % OCCLUSION_QUERIES_PER_OBJECT;
+                if (!object.pending[slot])
+                    continue;
+
+                GLint available = 0;
+                glGetQueryObjectiv(object.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                    break;
+
+                GLint anySamples = 0;
+                glGetQueryObjectiv(object.queries[slot], GL_QUERY_RESULT, &anySamples);
+                object.visible = anySamples != 0;
+                if (object.conditional[slot] && !object.visible)
+                    DrawsSkipped++;
+                object.pending[slot] = false;
+            }
+        }
+    }
+};
+
+#endif
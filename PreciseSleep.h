@@ -0,0 +1,129 @@
+#ifndef PRECISE_SLEEP_H
+#define PRECISE_SLEEP_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <timeapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm.lib")
+#endif
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002    // Windows 10 1803 and later, older SDKs lack the name
+#endif
+#endif
+
+// Default sleep values
+const double SLEEP_OVERSHOOT_INITIAL = 0.002;   // assumed oversleep before any sleeps have been measured, in seconds
+
+
+// Waits until a steady_clock deadline without spinning through most of the wait. Sleeps for the remaining time minus a
+// pessimistic guess of how much the OS will oversleep, then spins the last bit. The oversleep is measured as it goes, so the
+// spin stays short where the timer is fine and grows automatically where the scheduler is coarse.
+// On Windows the default timer period is about 15.6 ms, which would turn any frame rate limit into mostly spinning. A high
+// resolution waitable timer is used where there is one (Windows 10 1803+), otherwise the timer period is raised to 1 ms with
+// timeBeginPeriod for as long as the sleeper exists.
+class PreciseSleeper
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    PreciseSleeper()
+    {
+#ifdef _WIN32
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (timer == NULL)
+            raisedTimerPeriod = timeBeginPeriod(1) == TIMERR_NOERROR;
+#endif
+    }
+
+    ~PreciseSleeper()
+    {
+#ifdef _WIN32
+        if (timer != NULL)
+            CloseHandle(timer);
+        if (raisedTimerPeriod)
+            timeEndPeriod(1);
+#endif
+    }
+
+    PreciseSleeper(const PreciseSleeper&) = delete;
+    PreciseSleeper& operator=(const PreciseSleeper&) = delete;
+
+    void SleepUntil(clock::time_point deadline)
+    {
+        clock::time_point now = clock::now();
+        double remaining = std::chrono::duration<double>(deadline - now).count();
+        while (remaining > overshootEstimate()) {
+            double request = remaining - overshootEstimate();
+            sleepFor(request);
+            clock::time_point woke = clock::now();
+            recordOvershoot(std::chrono::duration<double>(woke - now).count() - request);
+            now = woke;
+            remaining = std::chrono::duration<double>(deadline - now).count();
+        }
+
+        while (clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE timer = NULL;
+    bool raisedTimerPeriod = false;
+#endif
+
+    // running mean / variance of how much longer than requested a sleep takes
+    double overshootMean = SLEEP_OVERSHOOT_INITIAL;
+    double overshootM2 = 0.0;
+    unsigned int overshootCount = 1;
+
+    void sleepFor(double seconds)
+    {
+#ifdef _WIN32
+        if (timer != NULL) {
+            LARGE_INTEGER due;
+            due.QuadPart = -(LONGLONG)(seconds * 1e7);  // relative, in 100 ns units
+            if (SetWaitableTimerEx(timer, &due, 0, NULL, NULL, NULL, 0)) {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+
+    // sleep only while the remaining time exceeds a pessimistic guess of the next oversleep
+    double overshootEstimate() const
+    {
+        double deviation = overshootCount > 1 ? std::sqrt(overshootM2 / (overshootCount - 1)) : 0.0;
+        return overshootMean + deviation;
+    }
+
+    void recordOvershoot(double observed)
+    {
+        observed = std::max(observed, 0.0);
+        // restarted now and then, so one huge outlier (e.g. the window being dragged) does not disable sleeping for good
+        if (overshootCount >= 1000) {
+            overshootCount = 1;
+            overshootM2 = 0.0;
+        }
+        overshootCount++;
+        double delta = observed - overshootMean;
+        overshootMean += delta / overshootCount;
+        overshootM2 += delta * (observed - overshootMean);
+    }
+};
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Default pool values
+const double RESIZE_DEBOUNCE = 0.2;     // seconds a new window size has to stay unchanged before targets are reallocated for it
+const int TARGET_UNUSED_FRAMES = 120;   // free targets nobody acquired for this many frames are deleted
+
+
+// What a render target looks like; targets with equal descriptors are interchangeable
+struct RenderTargetDesc {
+    int width = 0;
+    int height = 0;
+    GLenum internalFormat = GL_RGBA8;
+    int samples = 0;    // 0 = plain GL_TEXTURE_2D, otherwise GL_TEXTURE_2D_MULTISAMPLE
+
+    bool operator<(const RenderTargetDesc& other) const
+    {
+        if (width != other.width) return width < other.width;
+        if (height != other.height) return height < other.height;
+        if (internalFormat != other.internalFormat) return internalFormat < other.internalFormat;
+        return samples < other.samples;
+    }
+};
+
+// A pooled texture. Owned by the pool, borrowed between Acquire and Release
+struct RenderTarget {
+    RenderTargetDesc desc;
+    unsigned int texture = 0;
+    size_t bytes = 0;
+    bool inUse = false;
+    unsigned long lastUsedFrame = 0;
+
+    GLenum Target() const { return desc.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D; }
+};
+
+
+// Hands out transient render target textures (and framebuffers built from them) by descriptor and keeps them across frames, so
+// passes that ask for the same kind of target every frame get the same texture back instead of a fresh allocation.
+//
+// Window resizes are debounced: RequestSize records the new window size, but Width()/Height(), which passes should size their
+// targets from, only switch to it once it has been stable for RESIZE_DEBOUNCE seconds. Dragging a window edge therefore costs
+// one reallocation at the end instead of one per frame; until then the old targets are simply stretched to the window.
+class RenderTargetPool
+{
+public:
+    RenderTargetPool(int width, int height) : settledWidth(width), settledHeight(height), requestedWidth(width), requestedHeight(height)
+    {
+    }
+
+    ~RenderTargetPool()
+    {
+        for (auto& entry : framebuffers)
+            glDeleteFramebuffers(1, &entry.second);
+        for (std::unique_ptr<RenderTarget>& target : targets)
+            glDeleteTextures(1, &target->texture);
+    }
+
+    // records the current window size; call every frame (or from the resize callback) with the time in seconds
+    void RequestSize(int width, int height, double time)
+    {
+        if (width <= 0 || height <= 0)
+            return;
+        if (width != requestedWidth || height != requestedHeight) {
+            requestedWidth = width;
+            requestedHeight = height;
+            requestTime = time;
+        }
+        if ((requestedWidth != settledWidth || requestedHeight != settledHeight) && time - requestTime >= RESIZE_DEBOUNCE) {
+            settledWidth = requestedWidth;
+            settledHeight = requestedHeight;
+        }
+    }
+
+    // size full resolution targets should have this frame
+    int Width() const { return settledWidth; }
+    int Height() const { return settledHeight; }
+
+    // returns a free target matching desc, allocating one only if there is none
+    RenderTarget* Acquire(const RenderTargetDesc& desc)
+    {
+        for (std::unique_ptr<RenderTarget>& target : targets) {
+            if (!target->inUse && !(target->desc < desc) && !(desc < target->desc)) {
+                target->inUse = true;
+                target->lastUsedFrame = frame;
+                return target.get();
+            }
+        }
+
+        std::unique_ptr<RenderTarget> target(new RenderTarget());
+        target->desc = desc;
+        target->bytes = (size_t)desc.width * desc.height * bytesPerPixel(desc.internalFormat) * std::max(desc.samples, 1);
+        target->inUse = true;
+        target->lastUsedFrame = frame;
+        allocate(*target);
+
+        Allocations++;
+        targets.push_back(std::move(target));
+        return targets.back().get();
+    }
+
+    void Release(RenderTarget* target)
+    {
+        if (target)
+            target->inUse = false;
+    }
+
+    // framebuffer with the given color and (optional) depth attachments, created once per attachment combination
+    unsigned int Framebuffer(const RenderTarget* color, const RenderTarget* depth)
+    {
+        std::pair<unsigned int, unsigned int> key(color ? color->texture : 0, depth ? depth->texture : 0);
+        auto found = framebuffers.find(key);
+        if (found != framebuffers.end())
+            return found->second;
+
+        unsigned int framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        if (color) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color->Target(), color->texture, 0);
+        }
+        else {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        if (depth)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment(depth->desc.internalFormat), depth->Target(), depth->texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER::POOLED_TARGET_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        framebuffers[key] = framebuffer;
+        return framebuffer;
+    }
+
+    // ages the pool: targets that stayed free for TARGET_UNUSED_FRAMES frames (e.g. the old size after a resize) are deleted
+    void EndFrame()
+    {
+        for (size_t i = 0; i < targets.size();) {
+            RenderTarget& target = *targets[i];
+            if (!target.inUse && frame - target.lastUsedFrame > (unsigned long)TARGET_UNUSED_FRAMES) {
+                destroy(target);
+                targets.erase(targets.begin() + i);
+            }
+            else {
+                i++;
+            }
+        }
+        frame++;
+    }
+
+    // VRAM held by the pool's textures, in use or not
+    size_t TransientBytes() const
+    {
+        size_t total = 0;
+        for (const std::unique_ptr<RenderTarget>& target : targets)
+            total += target->bytes;
+        return total;
+    }
+
+    size_t TargetCount() const { return targets.size(); }
+
+    // number of textures ever created, a growing count while nothing changes size means something is not being reused
+    unsigned int Allocations = 0;
+
+private:
+    std::vector<std::unique_ptr<RenderTarget>> targets;
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> framebuffers;
+    unsigned long frame = 0;
+
+    int settledWidth, settledHeight;
+    int requestedWidth, requestedHeight;
+    double requestTime = 0.0;
+
+    static bool isDepthFormat(GLenum format)
+    {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+            || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    static GLenum depthAttachment(GLenum format)
+    {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    }
+
+    static size_t bytesPerPixel(GLenum format)
+    {
+        switch (format) {
+        case GL_R8: return 1;
+        case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+        case GL_RGBA32F: return 16;
+        default: return 4;   // RGBA8, R32F, RG16F, R11F_G11F_B10F, 24/32 bit depth
+        }
+    }
+
+    void allocate(RenderTarget& target)
+    {
+        const RenderTargetDesc& desc = target.desc;
+        glGenTextures(1, &target.texture);
+        glBindTexture(target.Target(), target.texture);
+
+        if (desc.samples > 0) {
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internalFormat, desc.width, desc.height, GL_TRUE);
+        }
+        else {
+            // the client format only has to be compatible, no data is uploaded
+            GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+            if (desc.internalFormat == GL_DEPTH24_STENCIL8) {
+                format = GL_DEPTH_STENCIL;
+                type = GL_UNSIGNED_INT_24_8;
+            }
+            else if (desc.internalFormat == GL_DEPTH32F_STENCIL8) {
+                format = GL_DEPTH_STENCIL;
+                type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+            }
+            else if (isDepthFormat(desc.internalFormat)) {
+                format = GL_DEPTH_COMPONENT;
+                type = GL_FLOAT;
+            }
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, format, type, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(target.Target(), 0);
+    }
+
+    // deletes the texture and every cached framebuffer it is attached to
+    void destroy(RenderTarget& target)
+    {
+        for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+            if (it->first.first == target.texture || it->first.second == target.texture) {
+                glDeleteFramebuffers(1, &it->second);
+                it = framebuffers.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        glDeleteTextures(1, &target.texture);
+    }
+};
+
+#endif
@@ -80,6 +80,42 @@ class Shader {
             glDeleteShader(fragment);
         }
 
+        // constructor for vertex-only programs whose outputs are captured with transform feedback instead of rasterized.
+        // the captured varyings are written interleaved, in the order given, into the buffer bound at index 0
+        Shader(const char* vertexPath, const char* const* feedbackVaryings, int varyingCount)   {
+            std::string vertexCode;
+            std::ifstream vShaderFile;
+            vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+            try {
+                vShaderFile.open(vertexPath);
+                std::stringstream vShaderStream;
+                vShaderStream << vShaderFile.rdbuf();
+                vShaderFile.close();
+                vertexCode = vShaderStream.str();
+            }
+
+            catch (const std::ifstream::failure& e) {
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            }
+
+            const char* vShaderCode = vertexCode.c_str();
+
+            unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertex, 1, &vShaderCode, NULL);
+            glCompileShader(vertex);
+            checkCompileErrors(vertex, "VERTEX");
+
+            // varyings have to be declared before linking
+            ID = glCreateProgram();
+            glAttachShader(ID, vertex);
+            glTransformFeedbackVaryings(ID, varyingCount, feedbackVaryings, GL_INTERLEAVED_ATTRIBS);
+            glLinkProgram(ID);
+            checkCompileErrors(ID, "PROGRAM");
+
+            glDeleteShader(vertex);
+        }
+
         // use/activate the shader
         void use() {
             glUseProgram(ID);
@@ -97,6 +133,18 @@ class Shader {
             glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
         }
 
+        void setBlockBinding(const std::string& name, unsigned int binding) const {
+            glUniformBlockBinding(ID, glGetUniformBlockIndex(ID, name.c_str()), binding);
+        }
+
+        void setVec3(const std::string& name, const glm::vec3& value) const {
+            glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+        }
+
+        void setMat4(const std::string& name, const glm::mat4& value) const {
+            glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        }
+
     private:
 
         //Compilation Error Handling
@@ -0,0 +1,177 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "PreciseSleep.h"
+
+// Default simulation values
+const double SIMULATION_TICK_RATE = 60.0;   // ticks per second
+const int SIMULATION_MAX_CATCH_UP = 5;      // ticks run back to back after a stall before the clock is reset
+const float MIX_SPEED = 0.3f;               // texture mix change per second while a key is held
+
+
+// What the render thread samples from the window every frame. GLFW can only be polled on the main thread, so the simulation thread
+// only ever sees this copy
+struct SimulationInput {
+    bool forward = false;
+    bool backward = false;
+    bool left = false;
+    bool right = false;
+    bool mixUp = false;
+    bool mixDown = false;
+    // camera orientation, owned by the render thread (mouse look is late latched there)
+    glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 rightVector = glm::vec3(1.0f, 0.0f, 0.0f);
+};
+
+// Everything the renderer needs from one simulation tick
+struct SimulationSnapshot {
+    double wallTime = 0.0;          // when the tick was produced, on the simulation clock
+    double simulationTime = 0.0;    // drives object animation
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float mixValue = 0.0f;
+};
+
+
+// Fixed-rate simulation on its own thread. Every tick produces a snapshot; the last two are kept (double buffered) and the render
+// thread interpolates between them, so frame rate and simulation rate are independent and motion stays smooth at either.
+class Simulation
+{
+public:
+    float MovementSpeed;
+
+    Simulation(const SimulationSnapshot& initial, double tickRate = SIMULATION_TICK_RATE, float movementSpeed = 2.5f)
+        : MovementSpeed(movementSpeed), tickLength(1.0 / tickRate), state(initial), previous(initial), current(initial)
+    {
+    }
+
+    ~Simulation()
+    {
+        Stop();
+    }
+
+    void Start()
+    {
+        running = true;
+        thread = std::thread(&Simulation::run, this);
+    }
+
+    void Stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void SetInput(const SimulationInput& newInput)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input = newInput;
+    }
+
+    double TickLength() const { return tickLength; }
+
+    // seconds on the clock that snapshot wallTime uses
+    double Now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    // blends the last two snapshots. The renderer stays up to one tick behind the simulation in exchange for never extrapolating
+    SimulationSnapshot Interpolate(double now) const
+    {
+        SimulationSnapshot a, b;
+        {
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            a = previous;
+            b = current;
+        }
+
+        float alpha = (float)std::min(std::max((now - b.wallTime) / tickLength, 0.0), 1.0);
+
+        SimulationSnapshot result;
+        result.wallTime = now;
+        result.simulationTime = a.simulationTime + (b.simulationTime - a.simulationTime) * alpha;
+        result.cameraPosition = glm::mix(a.cameraPosition, b.cameraPosition, alpha);
+        result.mixValue = a.mixValue + (b.mixValue - a.mixValue) * alpha;
+        return result;
+    }
+
+private:
+    double tickLength;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::atomic<bool> running{ false };
+    std::thread thread;
+    PreciseSleeper sleeper;             // only used by the simulation thread
+
+    std::mutex inputMutex;
+    SimulationInput input;
+
+    // only touched by the simulation thread
+    SimulationSnapshot state;
+
+    mutable std::mutex snapshotMutex;
+    SimulationSnapshot previous;
+    SimulationSnapshot current;
+
+    void run()
+    {
+        double nextTick = Now();
+        while (running) {
+            double now = Now();
+            if (now < nextTick) {
+                // a plain sleep_for rounds up to the OS timer period (about 15.6 ms on Windows), which bunches the ticks up
+                sleeper.SleepUntil(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(nextTick)));
+                continue;
+            }
+
+            // after a long stall (debugger, window drag) drop the backlog instead of fast forwarding through it
+            if (now - nextTick > SIMULATION_MAX_CATCH_UP * tickLength)
+                nextTick = now;
+
+            step();
+            nextTick += tickLength;
+        }
+    }
+
+    void step()
+    {
+        SimulationInput tickInput;
+        {
+            std::lock_guard<std::mutex> lock(inputMutex);
+            tickInput = input;
+        }
+
+        float dt = (float)tickLength;
+        float velocity = MovementSpeed * dt;
+        if (tickInput.forward)
+            state.cameraPosition += tickInput.front * velocity;
+        if (tickInput.backward)
+            state.cameraPosition -= tickInput.front * velocity;
+        if (tickInput.left)
+            state.cameraPosition -= tickInput.rightVector * velocity;
+        if (tickInput.right)
+            state.cameraPosition += tickInput.rightVector * velocity;
+
+        if (tickInput.mixUp)
+            state.mixValue = std::min(state.mixValue + MIX_SPEED * dt, 1.0f);
+        if (tickInput.mixDown)
+            state.mixValue = std::max(state.mixValue - MIX_SPEED * dt, 0.0f);
+
+        state.simulationTime += tickLength;
+        state.wallTime = Now();
+
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        previous = current;
+        current = state;
+    }
+};
+
+#endif
@@ -0,0 +1,593 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Camera.h"
+#include "JobSystem.h"
+
+// Default spatial index values
+const int BVH_BINS = 16;                    // SAH candidate splits per axis
+const int BVH_MAX_LEAF_SIZE = 8;            // leaves never hold more objects than this
+const int BVH_MIN_SPLIT_SIZE = 4;           // nodes this small become leaves without evaluating any split
+const float BVH_TRAVERSAL_COST = 1.0f;      // cost of visiting a node, relative to testing one object
+const size_t BVH_PARALLEL_BINNING = 65536;  // nodes at least this big bin their objects on the job system
+const int BVH_STACK_SIZE = 128;             // traversal stack, a walk never holds more than the tree depth + 1 entries
+const int BVH_SAH_MAX_DEPTH = 64;           // deeper nodes split at the object median, which halves them every level
+// after BVH_SAH_MAX_DEPTH at most 32 halvings are left for any 32-bit object count, so the deepest tree fits the stack
+static_assert(BVH_SAH_MAX_DEPTH + 32 + 1 <= BVH_STACK_SIZE, "BVH traversal stack too small for the depth limit");
+
+
+// 32 bytes, two per cache line. Children are always allocated as a pair, so one index finds both
+struct BvhNode {
+    glm::vec3 boundsMin;
+    uint32_t leftOrFirst;   // inner node: index of the left child (right is the next one), leaf: first entry in the object list
+    glm::vec3 boundsMax;
+    uint32_t count;         // objects in a leaf, 0 for inner nodes
+
+    bool IsLeaf() const { return count > 0; }
+};
+
+
+// An object's bounds as stored in the index. Builds partition these in place, so a leaf's objects sit next to each other
+struct BvhEntry {
+    glm::vec3 boundsMin;
+    uint32_t object;
+    glm::vec3 boundsMax;
+    uint32_t padding;
+
+    glm::vec3 Centroid() const { return (boundsMin + boundsMax) * 0.5f; }
+};
+
+
+// Bounding volume hierarchy over axis aligned object bounds, built top down with binned SAH splits into one flat node array.
+// Queries walk it with a small fixed stack and return object indices in no particular order. SAH splits can be very uneven, so
+// past BVH_SAH_MAX_DEPTH the build falls back to median splits to keep the depth within that stack. Objects that move can be
+// refit in place, which keeps the tree valid (only the quality degrades) until the next full Build.
+//
+// Large builds run on the job system: the big nodes near the root bin their objects in parallel, and once there are enough
+// independent subtrees they are built on the workers, each allocating its child pairs from one shared atomic counter.
+class SpatialIndex
+{
+public:
+    void Build(const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t count, JobSystem* jobs = nullptr)
+    {
+        entries.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            entries[i].boundsMin = boundsMin[i];
+            entries[i].boundsMax = boundsMax[i];
+            entries[i].object = (uint32_t)i;
+            entries[i].padding = 0;
+        }
+
+        nodes.resize(std::max<size_t>(2 * count, 1));
+        nodesUsed = 1;
+        nodes[0].leftOrFirst = 0;
+        nodes[0].count = (uint32_t)count;
+        updateBounds(nodes[0]);
+        if (count == 0)
+            return;
+
+        // split breadth first on this thread until there are enough subtrees to keep every worker busy
+        std::vector<uint32_t> open(1, 0u), subtrees;
+        int depth = 0;
+        size_t wanted = jobs ? (jobs->WorkerCount() + 1) * 4 : 1;
+        while (!open.empty() && open.size() + subtrees.size() < wanted) {
+            std::vector<uint32_t> next;
+            for (uint32_t node : open) {
+                if (split(node, depth, jobs)) {
+                    next.push_back(nodes[node].leftOrFirst);
+                    next.push_back(nodes[node].leftOrFirst + 1);
+                }
+            }
+            open.swap(next);
+            depth++;
+        }
+        subtrees.insert(subtrees.end(), open.begin(), open.end());
+
+        if (jobs) {
+            jobs->ParallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    buildSubtree(subtrees[i], depth);
+            });
+        }
+        else {
+            for (uint32_t node : subtrees)
+                buildSubtree(node, depth);
+        }
+        nodes.resize(nodesUsed);
+    }
+
+    // updates the bounds of every object (same count as the last Build) and every node, keeping the tree's topology
+    void Refit(const glm::vec3* boundsMin, const glm::vec3* boundsMax)
+    {
+        for (BvhEntry& entry : entries) {
+            entry.boundsMin = boundsMin[entry.object];
+            entry.boundsMax = boundsMax[entry.object];
+        }
+
+        // children always come after their parent, so walking backwards visits them first
+        for (size_t i = nodes.size(); i-- > 0;) {
+            BvhNode& node = nodes[i];
+            if (node.IsLeaf()) {
+                updateBounds(node);
+            }
+            else {
+                const BvhNode& left = nodes[node.leftOrFirst];
+                const BvhNode& right = nodes[node.leftOrFirst + 1];
+                node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+                node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+            }
+        }
+    }
+
+    size_t NodeCount() const { return nodes.size(); }
+    size_t ObjectCount() const { return entries.size(); }
+    const std::vector<BvhNode>& Nodes() const { return nodes; }
+
+    // objects whose bounds overlap the box
+    void QueryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& out) const
+    {
+        traverse(out, [&](const glm::vec3& nodeMin, const glm::vec3& nodeMax) {
+            return glm::all(glm::lessThanEqual(nodeMin, boxMax)) && glm::all(glm::lessThanEqual(boxMin, nodeMax));
+        });
+    }
+
+    // objects whose bounds come within radius of center
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const
+    {
+        float radiusSquared = radius * radius;
+        traverse(out, [&](const glm::vec3& nodeMin, const glm::vec3& nodeMax) {
+            glm::vec3 offset = center - glm::clamp(center, nodeMin, nodeMax);
+            return glm::dot(offset, offset) <= radiusSquared;
+        });
+    }
+
+    // objects whose bounds are at least partly inside the planes (normals pointing inward, as Camera::GetFrustumPlanes)
+    void QueryFrustum(const glm::vec4* planes, std::vector<uint32_t>& out) const
+    {
+        if (nodes.empty() || entries.empty())
+            return;
+
+        // besides the stack entry, remember which planes the node is already known to be fully inside of
+        struct Entry { uint32_t node; uint32_t planeMask; };
+        Entry stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = { 0u, 0x3Fu };
+        while (top > 0) {
+            Entry entry = stack[--top];
+            const BvhNode& node = nodes[entry.node];
+
+            uint32_t planeMask = entry.planeMask;
+            bool outside = false;
+            for (int i = 0; i < 6 && !outside; i++) {
+                if (!(planeMask & (1u << i)))
+                    continue;
+                const glm::vec4& plane = planes[i];
+                glm::vec3 farCorner(plane.x >= 0.0f ? node.boundsMax.x : node.boundsMin.x, plane.y >= 0.0f ? node.boundsMax.y : node.boundsMin.y, plane.z >= 0.0f ? node.boundsMax.z : node.boundsMin.z);
+                glm::vec3 nearCorner(plane.x >= 0.0f ? node.boundsMin.x : node.boundsMax.x, plane.y >= 0.0f ? node.boundsMin.y : node.boundsMax.y, plane.z >= 0.0f ? node.boundsMin.z : node.boundsMax.z);
+                if (glm::dot(glm::vec3(plane), farCorner) + plane.w < 0.0f)
+                    outside = true;
+                else if (glm::dot(glm::vec3(plane), nearCorner) + plane.w >= 0.0f)
+                    planeMask &= ~(1u << i);
+            }
+            if (outside)
+                continue;
+
+            // completely inside: everything below is in, no more tests
+            if (planeMask == 0 || node.IsLeaf()) {
+                if (planeMask == 0)
+                    appendSubtree(entry.node, out);
+                else
+                    appendLeaf(node, out, planes, planeMask);
+                continue;
+            }
+            stack[top++] = { node.leftOrFirst, planeMask };
+            stack[top++] = { node.leftOrFirst + 1, planeMask };
+        }
+    }
+
+    // closest object whose bounds the ray hits within maxDistance. direction doesn't need to be normalized, distances are
+    // in multiples of it
+    bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& hitObject, float& hitDistance) const
+    {
+        if (nodes.empty() || entries.empty())
+            return false;
+
+        glm::vec3 inverse = 1.0f / direction;   // infinities for axis parallel rays work out in the slab test
+        hitDistance = maxDistance;
+        bool hit = false;
+
+        uint32_t stack[BVH_STACK_SIZE];
+        int top = 0;
+        if (slab(origin, inverse, nodes[0].boundsMin, nodes[0].boundsMax, hitDistance) < hitDistance)
+            stack[top++] = 0;
+        while (top > 0) {
+            const BvhNode& node = nodes[stack[--top]];
+            if (node.IsLeaf()) {
+                for (uint32_t i = 0; i < node.count; i++) {
+                    const BvhEntry& entry = entries[node.leftOrFirst + i];
+                    float distance = slab(origin, inverse, entry.boundsMin, entry.boundsMax, hitDistance);
+                    if (distance < hitDistance) {
+                        hitDistance = distance;
+                        hitObject = entry.object;
+                        hit = true;
+                    }
+                }
+                continue;
+            }
+
+            // push the farther child first so the nearer one is visited first and shrinks hitDistance early
+            uint32_t near = node.leftOrFirst, far = node.leftOrFirst + 1;
+            float nearDistance = slab(origin, inverse, nodes[near].boundsMin, nodes[near].boundsMax, hitDistance);
+            float farDistance = slab(origin, inverse, nodes[far].boundsMin, nodes[far].boundsMax, hitDistance);
+            if (farDistance < nearDistance) {
+                std::swap(near, far);
+                std::swap(nearDistance, farDistance);
+            }
+            if (farDistance < hitDistance)
+                stack[top++] = far;
+            if (nearDistance < hitDistance)
+                stack[top++] = near;
+        }
+        return hit;
+    }
+
+private:
+    struct Bin {
+        glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        uint32_t count = 0;
+
+        void Grow(const glm::vec3& otherMin, const glm::vec3& otherMax)
+        {
+            boundsMin = glm::min(boundsMin, otherMin);
+            boundsMax = glm::max(boundsMax, otherMax);
+        }
+
+        float Area() const
+        {
+            glm::vec3 extent = boundsMax - boundsMin;
+            return count ? extent.x * extent.y + extent.y * extent.z + extent.z * extent.x : 0.0f;
+        }
+    };
+
+    std::vector<BvhNode> nodes;
+    std::atomic<uint32_t> nodesUsed{ 0 };
+    std::vector<BvhEntry> entries;  // leaves point at ranges of this
+
+    void updateBounds(BvhNode& node) const
+    {
+        node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (uint32_t i = 0; i < node.count; i++) {
+            node.boundsMin = glm::min(node.boundsMin, entries[node.leftOrFirst + i].boundsMin);
+            node.boundsMax = glm::max(node.boundsMax, entries[node.leftOrFirst + i].boundsMax);
+        }
+    }
+
+    // fills BVH_BINS bins per axis from the objects [first, first + count) whose centroids lie in centroidMin + [0, extent)
+    void binObjects(uint32_t first, uint32_t count, const glm::vec3& centroidMin, const glm::vec3& scale, Bin bins[3][BVH_BINS]) const
+    {
+        for (uint32_t i = 0; i < count; i++) {
+            const BvhEntry& entry = entries[first + i];
+            glm::vec3 position = (entry.Centroid() - centroidMin) * scale;
+            for (int axis = 0; axis < 3; axis++) {
+                int bin = std::min(BVH_BINS - 1, std::max(0, (int)position[axis]));
+                bins[axis][bin].count++;
+                bins[axis][bin].Grow(entry.boundsMin, entry.boundsMax);
+            }
+        }
+    }
+
+    // splits a leaf in two if that's cheaper by the surface area heuristic (or the leaf is too big), returns whether it did.
+    // depth is the node's distance from the root
+    bool split(uint32_t nodeIndex, int depth, JobSystem* jobs)
+    {
+        BvhNode& node = nodes[nodeIndex];
+        uint32_t first = node.leftOrFirst, count = node.count;
+        if (count <= (uint32_t)BVH_MIN_SPLIT_SIZE)
+            return false;
+        if (depth >= BVH_SAH_MAX_DEPTH)
+            return splitMedian(nodeIndex);
+
+        glm::vec3 centroidMin(std::numeric_limits<float>::max()), centroidMax(-std::numeric_limits<float>::max());
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 centroid = entries[first + i].Centroid();
+            centroidMin = glm::min(centroidMin, centroid);
+            centroidMax = glm::max(centroidMax, centroid);
+        }
+        glm::vec3 extent = centroidMax - centroidMin;
+
+        int axis = -1;
+        int splitBin = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        glm::vec3 scale(0.0f);
+        if (glm::max(extent.x, glm::max(extent.y, extent.z)) > 0.0f) {
+            for (int a = 0; a < 3; a++)
+                scale[a] = extent[a] > 0.0f ? BVH_BINS / extent[a] : 0.0f;
+
+            Bin bins[3][BVH_BINS];
+            if (jobs && count >= BVH_PARALLEL_BINNING) {
+                // per chunk bins, merged afterwards
+                size_t grain = BVH_PARALLEL_BINNING / 4;
+                std::vector<Bin> partial(((count + grain - 1) / grain) * 3 * BVH_BINS);
+                jobs->ParallelFor(count, grain, [&](size_t begin, size_t end) {
+                    binObjects(first + (uint32_t)begin, (uint32_t)(end - begin), centroidMin, scale, (Bin(*)[BVH_BINS])&partial[begin / grain * 3 * BVH_BINS]);
+                });
+                for (size_t chunk = 0; chunk < partial.size(); chunk += 3 * BVH_BINS) {
+                    for (int a = 0; a < 3; a++) {
+                        for (int b = 0; b < BVH_BINS; b++) {
+                            const Bin& other = partial[chunk + a * BVH_BINS + b];
+                            bins[a][b].count += other.count;
+                            bins[a][b].Grow(other.boundsMin, other.boundsMax);
+                        }
+                    }
+                }
+            }
+            else {
+                binObjects(first, count, centroidMin, scale, bins);
+            }
+
+            // sweep from both sides to get the cost of every plane between two bins
+            for (int a = 0; a < 3; a++) {
+                if (extent[a] <= 0.0f)
+                    continue;
+                float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+                uint32_t leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+                Bin left, right;
+                for (int i = 0; i < BVH_BINS - 1; i++) {
+                    left.count += bins[a][i].count;
+                    left.Grow(bins[a][i].boundsMin, bins[a][i].boundsMax);
+                    leftCount[i] = left.count;
+                    leftArea[i] = left.Area();
+                    right.count += bins[a][BVH_BINS - 1 - i].count;
+                    right.Grow(bins[a][BVH_BINS - 1 - i].boundsMin, bins[a][BVH_BINS - 1 - i].boundsMax);
+                    rightCount[BVH_BINS - 2 - i] = right.count;
+                    rightArea[BVH_BINS - 2 - i] = right.Area();
+                }
+                for (int i = 0; i < BVH_BINS - 1; i++) {
+                    float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                    if (leftCount[i] > 0 && rightCount[i] > 0 && cost < bestCost) {
+                        bestCost = cost;
+                        axis = a;
+                        splitBin = i + 1;
+                    }
+                }
+            }
+        }
+
+        glm::vec3 size = node.boundsMax - node.boundsMin;
+        float parentArea = size.x * size.y + size.y * size.z + size.z * size.x;
+        float leafCost = count * parentArea;
+        float splitCost = BVH_TRAVERSAL_COST * parentArea + bestCost;
+        if (axis >= 0 && splitCost >= leafCost && count <= (uint32_t)BVH_MAX_LEAF_SIZE)
+            return false;
+
+        uint32_t leftCount;
+        if (axis >= 0) {
+            BvhEntry* begin = &entries[first];
+            // same bin computation as binObjects, so the split matches the counts the cost was based on exactly
+            BvhEntry* middle = std::partition(begin, begin + count, [&](const BvhEntry& entry) {
+                return std::min(BVH_BINS - 1, std::max(0, (int)((entry.Centroid()[axis] - centroidMin[axis]) * scale[axis]))) < splitBin;
+            });
+            leftCount = (uint32_t)(middle - begin);
+        }
+        else {
+            // every centroid in one spot: no plane separates them, halve the list if it's too long for a leaf
+            if (count <= (uint32_t)BVH_MAX_LEAF_SIZE)
+                return false;
+            leftCount = count / 2;
+        }
+        addChildren(nodeIndex, leftCount);
+        return true;
+    }
+
+    // splits a leaf that is too big at the median centroid along its longest axis, so both halves are the same size
+    bool splitMedian(uint32_t nodeIndex)
+    {
+        const BvhNode& node = nodes[nodeIndex];
+        uint32_t first = node.leftOrFirst, count = node.count;
+        if (count <= (uint32_t)BVH_MAX_LEAF_SIZE)
+            return false;
+
+        glm::vec3 centroidMin(std::numeric_limits<float>::max()), centroidMax(-std::numeric_limits<float>::max());
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 centroid = entries[first + i].Centroid();
+            centroidMin = glm::min(centroidMin, centroid);
+            centroidMax = glm::max(centroidMax, centroid);
+        }
+        glm::vec3 extent = centroidMax - centroidMin;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+        BvhEntry* begin = &entries[first];
+        std::nth_element(begin, begin + count / 2, begin + count, [axis](const BvhEntry& a, const BvhEntry& b) {
+            return a.Centroid()[axis] < b.Centroid()[axis];
+        });
+        addChildren(nodeIndex, count / 2);
+        return true;
+    }
+
+    // turns a leaf into an inner node whose children hold its first leftCount objects and the rest
+    void addChildren(uint32_t nodeIndex, uint32_t leftCount)
+    {
+        BvhNode& node = nodes[nodeIndex];
+        uint32_t first = node.leftOrFirst, count = node.count;
+        uint32_t leftIndex = nodesUsed.fetch_add(2);
+        BvhNode& leftChild = nodes[leftIndex];
+        BvhNode& rightChild = nodes[leftIndex + 1];
+        leftChild.leftOrFirst = first;
+        leftChild.count = leftCount;
+        rightChild.leftOrFirst = first + leftCount;
+        rightChild.count = count - leftCount;
+        updateBounds(leftChild);
+        updateBounds(rightChild);
+        node.leftOrFirst = leftIndex;
+        node.count = 0;
+    }
+
+    void buildSubtree(uint32_t root, int rootDepth)
+    {
+        std::vector<std::pair<uint32_t, int>> stack(1, std::make_pair(root, rootDepth));
+        while (!stack.empty()) {
+            uint32_t node = stack.back().first;
+            int depth = stack.back().second;
+            stack.pop_back();
+            if (split(node, depth, nullptr)) {
+                stack.emplace_back(nodes[node].leftOrFirst, depth + 1);
+                stack.emplace_back(nodes[node].leftOrFirst + 1, depth + 1);
+            }
+        }
+    }
+
+    template <typename Overlaps>
+    void traverse(std::vector<uint32_t>& out, const Overlaps& overlaps) const
+    {
+        if (nodes.empty() || entries.empty())
+            return;
+
+        uint32_t stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BvhNode& node = nodes[stack[--top]];
+            if (!overlaps(node.boundsMin, node.boundsMax))
+                continue;
+            if (node.IsLeaf()) {
+                for (uint32_t i = 0; i < node.count; i++) {
+                    const BvhEntry& entry = entries[node.leftOrFirst + i];
+                    if (overlaps(entry.boundsMin, entry.boundsMax))
+                        out.push_back(entry.object);
+                }
+                continue;
+            }
+            stack[top++] = node.leftOrFirst;
+            stack[top++] = node.leftOrFirst + 1;
+        }
+    }
+
+    void appendSubtree(uint32_t root, std::vector<uint32_t>& out) const
+    {
+        uint32_t stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = root;
+        while (top > 0) {
+            const BvhNode& node = nodes[stack[--top]];
+            if (node.IsLeaf()) {
+                for (uint32_t i = 0; i < node.count; i++)
+                    out.push_back(entries[node.leftOrFirst + i].object);
+                continue;
+            }
+            stack[top++] = node.leftOrFirst;
+            stack[top++] = node.leftOrFirst + 1;
+        }
+    }
+
+    void appendLeaf(const BvhNode& node, std::vector<uint32_t>& out, const glm::vec4* planes, uint32_t planeMask) const
+    {
+        for (uint32_t i = 0; i < node.count; i++) {
+            const BvhEntry& entry = entries[node.leftOrFirst + i];
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                if (!(planeMask & (1u << p)))
+                    continue;
+                const glm::vec4& plane = planes[p];
+                glm::vec3 farCorner(plane.x >= 0.0f ? entry.boundsMax.x : entry.boundsMin.x, plane.y >= 0.0f ? entry.boundsMax.y : entry.boundsMin.y, plane.z >= 0.0f ? entry.boundsMax.z : entry.boundsMin.z);
+                inside = glm::dot(glm::vec3(plane), farCorner) + plane.w >= 0.0f;
+            }
+            if (inside)
+                out.push_back(entry.object);
+        }
+    }
+
+    // entry distance of the ray into the box, or infinity if it misses it before limit
+    static float slab(const glm::vec3& origin, const glm::vec3& inverse, const glm::vec3& boxMin, const glm::vec3& boxMax, float limit)
+    {
+        glm::vec3 t0 = (boxMin - origin) * inverse;
+        glm::vec3 t1 = (boxMax - origin) * inverse;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, limit));
+        return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+    }
+};
+
+
+// Builds an index over count random boxes (serial and on the job system) and times queries against a linear scan
+inline void BenchmarkSpatialIndex(JobSystem& jobs, size_t count)
+{
+    std::vector<glm::vec3> mins(count), maxs(count);
+    BenchmarkRandom random(4242u);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center(random.NextFloat() * 2000.0f - 1000.0f, random.NextFloat() * 200.0f, random.NextFloat() * 2000.0f - 1000.0f);
+        glm::vec3 half(0.5f + random.NextFloat() * 2.0f);
+        mins[i] = center - half;
+        maxs[i] = center + half;
+    }
+
+    SpatialIndex index;
+    auto start = std::chrono::high_resolution_clock::now();
+    index.Build(mins.data(), maxs.data(), count);
+    auto serialEnd = std::chrono::high_resolution_clock::now();
+    index.Build(mins.data(), maxs.data(), count, &jobs);
+    auto parallelEnd = std::chrono::high_resolution_clock::now();
+    index.Refit(mins.data(), maxs.data());
+    auto refitEnd = std::chrono::high_resolution_clock::now();
+
+    Camera camera(glm::vec3(0.0f, 50.0f, 0.0f));
+    camera.SetAspectRatio(16.0f / 9.0f);
+    camera.SetClipPlanes(0.1f, 300.0f);
+    const glm::vec4* planes = camera.GetFrustumPlanes();
+
+    const int queries = 100;
+    std::vector<uint32_t> results;
+    size_t indexHits = 0, linearHits = 0;
+
+    auto queryStart = std::chrono::high_resolution_clock::now();
+    for (int q = 0; q < queries; q++) {
+        results.clear();
+        index.QuerySphere(glm::vec3(q * 10.0f - 500.0f, 100.0f, 0.0f), 50.0f, results);
+        indexHits += results.size();
+        results.clear();
+        index.QueryFrustum(planes, results);
+        indexHits += results.size();
+    }
+    auto linearStart = std::chrono::high_resolution_clock::now();
+    for (int q = 0; q < queries; q++) {
+        glm::vec3 center(q * 10.0f - 500.0f, 100.0f, 0.0f);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 offset = center - glm::clamp(center, mins[i], maxs[i]);
+            linearHits += glm::dot(offset, offset) <= 2500.0f;
+            linearHits += camera.IsBoxInFrustum(mins[i], maxs[i]);
+        }
+    }
+    auto linearEnd = std::chrono::high_resolution_clock::now();
+
+    uint32_t hitObject = 0;
+    float hitDistance = 0.0f;
+    auto rayStart = std::chrono::high_resolution_clock::now();
+    unsigned int rayHits = 0;
+    for (int q = 0; q < 10000; q++) {
+        glm::vec3 direction(std::cos(q * 0.01f), -0.05f, std::sin(q * 0.01f));
+        rayHits += index.Raycast(glm::vec3(0.0f, 100.0f, 0.0f), direction, 2000.0f, hitObject, hitDistance);
+    }
+    auto rayEnd = std::chrono::high_resolution_clock::now();
+
+    std::cout << "BENCHMARK::SPATIAL_INDEX " << count << " objects, " << index.NodeCount() << " nodes" << std::endl;
+    std::cout << "  build: " << BenchmarkMs(start, serialEnd) << " ms (1 thread), " << BenchmarkMs(serialEnd, parallelEnd) << " ms (" << jobs.WorkerCount() + 1
+        << " threads), refit " << BenchmarkMs(parallelEnd, refitEnd) << " ms" << std::endl;
+    std::cout << "  sphere + frustum query: " << BenchmarkMs(queryStart, linearStart) / queries << " ms, linear scan " << BenchmarkMs(linearStart, linearEnd) / queries
+        << " ms (" << indexHits << " / " << linearHits << " hits)" << std::endl;
+    std::cout << "  raycast: " << BenchmarkMs(rayStart, rayEnd) * 1000.0 / 10000 << " us per ray, " << rayHits << " of 10000 hit" << std::endl;
+}
+
+#endif
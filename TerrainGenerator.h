@@ -0,0 +1,458 @@
+#ifndef TERRAIN_GENERATOR_H
+#define TERRAIN_GENERATOR_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "VoxelChunk.h"
+
+// Default terrain generation values
+const unsigned int TERRAIN_DEFAULT_SEED = 1337u;
+const int TERRAIN_SAMPLE_SPACING = 4;                                   // blocks between density samples, trilinear in between
+const int TERRAIN_SAMPLES = CHUNK_SIZE / TERRAIN_SAMPLE_SPACING + 1;    // samples along x and z of a chunk
+const int TERRAIN_SAMPLES_Y = TERRAIN_SAMPLES + 1;                      // one layer more above the chunk, see Generate
+const float TERRAIN_BASE_HEIGHT = 34.0f;                                // world y of the average surface
+const float TERRAIN_HEIGHT_AMPLITUDE = 24.0f;                           // 2D noise: hills and valleys
+const float TERRAIN_HEIGHT_FREQUENCY = 1.0f / 128.0f;
+const int TERRAIN_HEIGHT_OCTAVES = 5;
+const float TERRAIN_DENSITY_AMPLITUDE = 10.0f;                          // 3D noise added on top: overhangs, arches, floating bits
+const float TERRAIN_DENSITY_FREQUENCY = 1.0f / 40.0f;
+const int TERRAIN_DENSITY_OCTAVES = 3;
+const int TERRAIN_DIRT_DEPTH = 3;                                       // blocks of dirt (or sand) under the surface
+const int TERRAIN_SAND_LEVEL = 24;                                      // surfaces below this world y are sand
+const int TERRAIN_ORE_VEINS = 12;                                       // tries per chunk, only stone turns into ore
+const int TERRAIN_ORE_VEIN_LENGTH = 6;
+
+
+// Integer lattice hash, the same in the scalar and the AVX2 noise
+inline uint32_t TerrainHash(int x, int y, int z, uint32_t seed)
+{
+    uint32_t h = seed ^ (uint32_t)x * 0x27d4eb2du ^ (uint32_t)y * 0x165667b1u ^ (uint32_t)z * 0x9e3779b1u;
+    h ^= h >> 15;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+// One of Perlin's 12 edge gradients (16 with 4 repeated) picked by the low hash bits, dotted with the offset to the corner.
+// A table instead of Perlin's branches, which mispredict on every other corner. Each product is exact (the components are
+// 0 or +-1), so the sum is the same as the AVX2 version's
+inline float TerrainGradient(uint32_t hash, float x, float y, float z)
+{
+    static const float gradients[16][3] = {
+        { 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+        { 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+        { 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+        { 1, 1, 0 }, { 0, -1, 1 }, { -1, 1, 0 }, { 0, -1, -1 }
+    };
+    const float* g = gradients[hash & 15];
+    return g[0] * x + g[1] * y + g[2] * z;
+}
+
+inline float TerrainFade(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+inline float TerrainLerp(float a, float b, float t)
+{
+    return a + t * (b - a);
+}
+
+// 3D gradient noise (improved Perlin noise with hashed gradients instead of a permutation table), roughly in [-1, 1]
+inline float GradientNoise(float x, float y, float z, uint32_t seed)
+{
+    float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+    int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+    x -= fx;
+    y -= fy;
+    z -= fz;
+    float u = TerrainFade(x), v = TerrainFade(y), w = TerrainFade(z);
+
+    float n000 = TerrainGradient(TerrainHash(ix, iy, iz, seed), x, y, z);
+    float n100 = TerrainGradient(TerrainHash(ix + 1, iy, iz, seed), x - 1.0f, y, z);
+    float n010 = TerrainGradient(TerrainHash(ix, iy + 1, iz, seed), x, y - 1.0f, z);
+    float n110 = TerrainGradient(TerrainHash(ix + 1, iy + 1, iz, seed), x - 1.0f, y - 1.0f, z);
+    float n001 = TerrainGradient(TerrainHash(ix, iy, iz + 1, seed), x, y, z - 1.0f);
+    float n101 = TerrainGradient(TerrainHash(ix + 1, iy, iz + 1, seed), x - 1.0f, y, z - 1.0f);
+    float n011 = TerrainGradient(TerrainHash(ix, iy + 1, iz + 1, seed), x, y - 1.0f, z - 1.0f);
+    float n111 = TerrainGradient(TerrainHash(ix + 1, iy + 1, iz + 1, seed), x - 1.0f, y - 1.0f, z - 1.0f);
+
+    float x00 = TerrainLerp(n000, n100, u), x10 = TerrainLerp(n010, n110, u);
+    float x01 = TerrainLerp(n001, n101, u), x11 = TerrainLerp(n011, n111, u);
+    return TerrainLerp(TerrainLerp(x00, x10, v), TerrainLerp(x01, x11, v), w);
+}
+
+// Octaves of gradient noise, each at twice the frequency and half the amplitude of the one before and with its own seed,
+// normalized to roughly [-1, 1]
+inline float FractalNoise(float x, float y, float z, int octaves, float frequency, uint32_t seed)
+{
+    float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+    for (int octave = 0; octave < octaves; octave++) {
+        sum += amplitude * GradientNoise(x * frequency, y * frequency, z * frequency, seed + (uint32_t)octave * 0x9e3779b9u);
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return sum * (1.0f / total);
+}
+
+#if defined(__AVX2__)
+inline __m256i terrainHash8(__m256i x, __m256i y, __m256i z, __m256i seed)
+{
+    __m256i h = _mm256_xor_si256(seed, _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x27d4eb2du)));
+    h = _mm256_xor_si256(h, _mm256_mullo_epi32(y, _mm256_set1_epi32((int)0x165667b1u)));
+    h = _mm256_xor_si256(h, _mm256_mullo_epi32(z, _mm256_set1_epi32((int)0x9e3779b1u)));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x85ebca6bu));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+}
+
+// TerrainGradient for 8 corners: the branches become blends, the negations xor the sign bit straight from the hash bits
+inline __m256 terrainGradient8(__m256i hash, __m256 x, __m256 y, __m256 z)
+{
+    __m256i g = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    __m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), g));
+    __m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), g));
+    __m256 useX = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(g, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(g, _mm256_set1_epi32(14))));
+    __m256 u = _mm256_blendv_ps(y, x, below8);
+    __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, useX), y, below4);
+    u = _mm256_xor_ps(u, _mm256_castsi256_ps(_mm256_slli_epi32(g, 31)));
+    v = _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(g, _mm256_set1_epi32(2)), 30)));
+    return _mm256_add_ps(u, v);
+}
+
+inline __m256 terrainFade8(__m256 t)
+{
+    __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+inline __m256 terrainLerp8(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+// GradientNoise at 8 points, operation for operation the same as the scalar version so both give the same terrain
+inline __m256 GradientNoise8(__m256 x, __m256 y, __m256 z, uint32_t seed)
+{
+    __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y), fz = _mm256_floor_ps(z);
+    __m256i ix = _mm256_cvttps_epi32(fx), iy = _mm256_cvttps_epi32(fy), iz = _mm256_cvttps_epi32(fz);
+    __m256i one = _mm256_set1_epi32(1), s = _mm256_set1_epi32((int)seed);
+    __m256i ix1 = _mm256_add_epi32(ix, one), iy1 = _mm256_add_epi32(iy, one), iz1 = _mm256_add_epi32(iz, one);
+    x = _mm256_sub_ps(x, fx);
+    y = _mm256_sub_ps(y, fy);
+    z = _mm256_sub_ps(z, fz);
+    __m256 x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.0f)), y1 = _mm256_sub_ps(y, _mm256_set1_ps(1.0f)), z1 = _mm256_sub_ps(z, _mm256_set1_ps(1.0f));
+    __m256 u = terrainFade8(x), v = terrainFade8(y), w = terrainFade8(z);
+
+    __m256 n000 = terrainGradient8(terrainHash8(ix, iy, iz, s), x, y, z);
+    __m256 n100 = terrainGradient8(terrainHash8(ix1, iy, iz, s), x1, y, z);
+    __m256 n010 = terrainGradient8(terrainHash8(ix, iy1, iz, s), x, y1, z);
+    __m256 n110 = terrainGradient8(terrainHash8(ix1, iy1, iz, s), x1, y1, z);
+    __m256 n001 = terrainGradient8(terrainHash8(ix, iy, iz1, s), x, y, z1);
+    __m256 n101 = terrainGradient8(terrainHash8(ix1, iy, iz1, s), x1, y, z1);
+    __m256 n011 = terrainGradient8(terrainHash8(ix, iy1, iz1, s), x, y1, z1);
+    __m256 n111 = terrainGradient8(terrainHash8(ix1, iy1, iz1, s), x1, y1, z1);
+
+    __m256 x00 = terrainLerp8(n000, n100, u), x10 = terrainLerp8(n010, n110, u);
+    __m256 x01 = terrainLerp8(n001, n101, u), x11 = terrainLerp8(n011, n111, u);
+    return terrainLerp8(terrainLerp8(x00, x10, v), terrainLerp8(x01, x11, v), w);
+}
+#endif
+
+// FractalNoise for count points given as separate x, y and z arrays, 8 points at a time with AVX2
+inline void FractalNoise(const float* x, const float* y, const float* z, float* out, size_t count, int octaves, float frequency, uint32_t seed)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    float total = 0.0f;
+    for (float octave = 0.0f, amplitude = 1.0f; octave < octaves; octave++, amplitude *= 0.5f)
+        total += amplitude;
+    __m256 normalize = _mm256_set1_ps(1.0f / total);
+    for (size_t batched = count & ~(size_t)7; i < batched; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        __m256 sum = _mm256_setzero_ps();
+        float amplitude = 1.0f, octaveFrequency = frequency;
+        for (int octave = 0; octave < octaves; octave++) {
+            __m256 f = _mm256_set1_ps(octaveFrequency);
+            __m256 n = GradientNoise8(_mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f), seed + (uint32_t)octave * 0x9e3779b9u);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitude), n));
+            amplitude *= 0.5f;
+            octaveFrequency *= 2.0f;
+        }
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(sum, normalize));
+    }
+#endif
+    // scalar remainder (or everything, without AVX2)
+    for (; i < count; i++)
+        out[i] = FractalNoise(x[i], y[i], z[i], octaves, frequency, seed);
+}
+
+
+// Density based terrain: a block is solid where height(x, z) - y + 3D noise is positive. The height field is 2D fractal noise
+// (the 3D noise on the y = 0 plane), the 3D term bends it into overhangs and arches. Solid blocks become grass on top with a few
+// blocks of dirt underneath (sand for low surfaces) and stone below, with ore veins in the stone.
+// Both noises are only evaluated on a lattice every TERRAIN_SAMPLE_SPACING blocks and interpolated trilinearly in between,
+// about 1/50th of the noise a per-block evaluation needs and the lattice is batched through the 8-wide FractalNoise.
+// Generate only reads the generator, so one generator can fill chunks on any number of threads at once. Everything about a
+// chunk follows from the world seed and the chunk's position, so a chunk comes out the same whichever thread generates it,
+// in whatever order, and matches its neighbors along the borders.
+class TerrainGenerator
+{
+public:
+    TerrainGenerator(unsigned int seed = TERRAIN_DEFAULT_SEED) : seed(seed)
+    {
+    }
+
+    unsigned int Seed() const { return seed; }
+
+    // seed for a chunk's own random features (ore), independent of the order chunks are generated in
+    unsigned int ChunkSeed(const glm::ivec3& position) const
+    {
+        return TerrainHash(position.x, position.y, position.z, seed ^ 0x68e31da4u);
+    }
+
+    void Generate(Chunk& chunk) const
+    {
+        // lattice sizes padded to whole batches of 8, the padding is evaluated but never read
+        const int columns = TERRAIN_SAMPLES * TERRAIN_SAMPLES, samples = TERRAIN_SAMPLES_Y * columns;
+        const int paddedColumns = (columns + 7) & ~7, paddedSamples = (samples + 7) & ~7;
+        float px[paddedSamples] = {}, py[paddedSamples] = {}, pz[paddedSamples] = {};
+        float height[paddedColumns], density[paddedSamples];
+
+        glm::ivec3 origin = chunk.Position * CHUNK_SIZE;
+        for (int iz = 0; iz < TERRAIN_SAMPLES; iz++)
+            for (int ix = 0; ix < TERRAIN_SAMPLES; ix++) {
+                px[iz * TERRAIN_SAMPLES + ix] = (float)(origin.x + ix * TERRAIN_SAMPLE_SPACING);
+                pz[iz * TERRAIN_SAMPLES + ix] = (float)(origin.z + iz * TERRAIN_SAMPLE_SPACING);
+            }
+        // py is still all zero: the height field is the y = 0 plane
+        FractalNoise(px, py, pz, height, paddedColumns, TERRAIN_HEIGHT_OCTAVES, TERRAIN_HEIGHT_FREQUENCY, seed);
+
+        for (int iy = 0; iy < TERRAIN_SAMPLES_Y; iy++)
+            for (int i = 0; i < columns; i++) {
+                px[iy * columns + i] = px[i];
+                py[iy * columns + i] = (float)(origin.y + iy * TERRAIN_SAMPLE_SPACING);
+                pz[iy * columns + i] = pz[i];
+            }
+        FractalNoise(px, py, pz, density, paddedSamples, TERRAIN_DENSITY_OCTAVES, TERRAIN_DENSITY_FREQUENCY, seed + 1u);
+
+        bool anySolid = false;
+        for (int i = 0; i < samples; i++) {
+            density[i] = TERRAIN_BASE_HEIGHT + TERRAIN_HEIGHT_AMPLITUDE * height[i % columns] - py[i] + TERRAIN_DENSITY_AMPLITUDE * density[i];
+            anySolid |= density[i] > 0.0f;
+        }
+        // interpolating never leaves the range of the samples
+        if (!anySolid) {
+            chunk.Fill(BLOCK_AIR);
+            return;
+        }
+
+        static thread_local std::vector<BlockId> blocks(CHUNK_VOLUME);
+        fillColumns(density, origin.y, blocks.data());
+        placeOre(ChunkSeed(chunk.Position), blocks.data());
+        chunk.Load(blocks.data());
+    }
+
+    // exact density at world block positions, noise evaluated per block without the lattice. For comparing against Generate
+    void Density(const glm::ivec3* positions, float* out, size_t count) const
+    {
+        const size_t batch = 256;
+        float px[batch], py[batch], pz[batch], zero[batch] = {}, height[batch];
+        for (size_t start = 0; start < count; start += batch) {
+            size_t n = std::min(batch, count - start);
+            for (size_t i = 0; i < n; i++) {
+                px[i] = (float)positions[start + i].x;
+                py[i] = (float)positions[start + i].y;
+                pz[i] = (float)positions[start + i].z;
+            }
+            FractalNoise(px, zero, pz, height, n, TERRAIN_HEIGHT_OCTAVES, TERRAIN_HEIGHT_FREQUENCY, seed);
+            FractalNoise(px, py, pz, out + start, n, TERRAIN_DENSITY_OCTAVES, TERRAIN_DENSITY_FREQUENCY, seed + 1u);
+            for (size_t i = 0; i < n; i++)
+                out[start + i] = TERRAIN_BASE_HEIGHT + TERRAIN_HEIGHT_AMPLITUDE * height[i] - py[i] + TERRAIN_DENSITY_AMPLITUDE * out[start + i];
+        }
+    }
+
+private:
+    unsigned int seed;
+
+    // Interpolates the lattice one row of blocks at a time, top down, so each column knows how deep under the surface a
+    // block is. The lattice reaches TERRAIN_SAMPLE_SPACING blocks above the chunk, which covers the dirt layer of a
+    // surface in the chunk above and keeps the layering continuous across chunk tops
+    void fillColumns(const float* density, int originY, BlockId* blocks) const
+    {
+        const int S = TERRAIN_SAMPLES, spacing = TERRAIN_SAMPLE_SPACING;
+        const float step = 1.0f / (float)spacing;
+        // solid blocks above in each column since the last air, -1 over air. Above the lattice counts as deep underground
+        int depth[CHUNK_SIZE * CHUNK_SIZE];
+        int surface[CHUNK_SIZE * CHUNK_SIZE];
+        std::fill(depth, depth + CHUNK_SIZE * CHUNK_SIZE, TERRAIN_DIRT_DEPTH);
+        std::fill(surface, surface + CHUNK_SIZE * CHUNK_SIZE, 0);
+
+        for (int y = (TERRAIN_SAMPLES_Y - 1) * spacing - 1; y >= 0; y--) {
+            int iy = y / spacing;
+            float ty = (float)(y % spacing) * step;
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                int iz = z / spacing;
+                float tz = (float)(z % spacing) * step;
+                // bilinear in y and z at every lattice x, then linear along the row
+                float row[TERRAIN_SAMPLES];
+                for (int ix = 0; ix < S; ix++) {
+                    const float* c = density + (iy * S + iz) * S + ix;
+                    float below = TerrainLerp(c[0], c[S], tz);
+                    float above = TerrainLerp(c[S * S], c[S * S + S], tz);
+                    row[ix] = TerrainLerp(below, above, ty);
+                }
+
+                float d[CHUNK_SIZE];
+                for (int ix = 0; ix + 1 < S; ix++)
+                    for (int i = 0; i < spacing; i++)
+                        d[ix * spacing + i] = TerrainLerp(row[ix], row[ix + 1], (float)i * step);
+
+                // written without branches, the surface is too irregular to predict
+                int* columnDepth = depth + z * CHUNK_SIZE;
+                int* columnSurface = surface + z * CHUNK_SIZE;
+                BlockId out[CHUNK_SIZE];
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    bool solid = d[x] > 0.0f;
+                    int below = std::min(columnDepth[x] + 1, TERRAIN_DIRT_DEPTH + 1);
+                    columnDepth[x] = solid ? below : -1;
+                    columnSurface[x] = below == 0 ? originY + y : columnSurface[x];
+                    BlockId layer = columnSurface[x] < TERRAIN_SAND_LEVEL ? BLOCK_SAND : below == 0 ? BLOCK_GRASS : BLOCK_DIRT;
+                    out[x] = !solid ? (BlockId)BLOCK_AIR : below > TERRAIN_DIRT_DEPTH ? (BlockId)BLOCK_STONE : layer;
+                }
+                if (y < CHUNK_SIZE)
+                    std::copy(out, out + CHUNK_SIZE, blocks + (y * CHUNK_SIZE + z) * CHUNK_SIZE);
+            }
+        }
+    }
+
+    // short random walks through the chunk that turn the stone they cross into ore
+    static void placeOre(unsigned int random, BlockId* blocks)
+    {
+        auto next = [&random]() {
+            random = random * 1664525u + 1013904223u;
+            return random >> 8;
+        };
+        for (int vein = 0; vein < TERRAIN_ORE_VEINS; vein++) {
+            glm::ivec3 p(next() % CHUNK_SIZE, next() % CHUNK_SIZE, next() % CHUNK_SIZE);
+            for (int i = 0; i < TERRAIN_ORE_VEIN_LENGTH; i++) {
+                BlockId& block = blocks[(p.y * CHUNK_SIZE + p.z) * CHUNK_SIZE + p.x];
+                if (block == BLOCK_STONE)
+                    block = BLOCK_ORE;
+                unsigned int step = next();
+                p[step % 3] = glm::clamp(p[step % 3] + ((step & 8) ? 1 : -1), 0, CHUNK_SIZE - 1);
+            }
+        }
+    }
+};
+
+
+// Times the noise scalar against 8-wide, then generates a grid of chunks on one thread and as one job per chunk, checks both
+// give the same blocks, and compares the lattice against evaluating the noise at every block
+inline void BenchmarkTerrainGeneration(JobSystem& jobs, int chunksX, int chunksY, int chunksZ)
+{
+    // noise throughput
+    const size_t points = 1 << 20;
+    std::vector<float> x(points), y(points), z(points), batched(points), scalar(points);
+    BenchmarkRandom random(1234u);
+    for (size_t i = 0; i < points; i++) {
+        x[i] = (float)(random.Next() & 0xFFFF) * 0.37f - 10000.0f;
+        y[i] = (float)(random.Next() >> 16) * 0.5f;
+        z[i] = (float)(random.Next() & 0xFFFF) * 0.29f - 9000.0f;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < points; i++)
+        scalar[i] = FractalNoise(x[i], y[i], z[i], 4, 0.02f, 99u);
+    auto middle = std::chrono::high_resolution_clock::now();
+    FractalNoise(x.data(), y.data(), z.data(), batched.data(), points, 4, 0.02f, 99u);
+    auto end = std::chrono::high_resolution_clock::now();
+    float maxError = 0.0f;
+    for (size_t i = 0; i < points; i++)
+        maxError = std::max(maxError, std::abs(scalar[i] - batched[i]));
+    double scalarMs = BenchmarkMs(start, middle), batchMs = BenchmarkMs(middle, end);
+
+    // chunks on this thread, then one job per chunk
+    TerrainGenerator generator;
+    std::vector<glm::ivec3> positions;
+    for (int cy = 0; cy < chunksY; cy++)
+        for (int cz = 0; cz < chunksZ; cz++)
+            for (int cx = 0; cx < chunksX; cx++)
+                positions.emplace_back(cx - chunksX / 2, cy, cz - chunksZ / 2);
+    std::vector<Chunk> serial(positions.begin(), positions.end()), parallel(positions.begin(), positions.end());
+
+    start = std::chrono::high_resolution_clock::now();
+    for (Chunk& chunk : serial)
+        generator.Generate(chunk);
+    middle = std::chrono::high_resolution_clock::now();
+    jobs.ParallelFor(parallel.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            generator.Generate(parallel[i]);
+    });
+    end = std::chrono::high_resolution_clock::now();
+    double serialMs = BenchmarkMs(start, middle), parallelMs = BenchmarkMs(middle, end);
+
+    size_t mismatched = 0, solid = 0;
+    std::vector<BlockId> a(SECTION_VOLUME), b(SECTION_VOLUME);
+    for (size_t i = 0; i < serial.size(); i++)
+        for (int sy = 0; sy < CHUNK_SECTIONS; sy++)
+            for (int sz = 0; sz < CHUNK_SECTIONS; sz++)
+                for (int sx = 0; sx < CHUNK_SECTIONS; sx++) {
+                    serial[i].Section(sx, sy, sz).Decode(a.data());
+                    parallel[i].Section(sx, sy, sz).Decode(b.data());
+                    mismatched += !std::equal(a.begin(), a.end(), b.begin());
+                    solid += serial[i].Section(sx, sy, sz).NonAirCount();
+                }
+
+    // the lattice against per-block noise, on the chunks with a surface in them
+    std::vector<glm::ivec3> blocks;
+    std::vector<const Chunk*> compared;
+    for (const Chunk& chunk : serial) {
+        if (chunk.IsEmpty() || compared.size() >= 16)
+            continue;
+        compared.push_back(&chunk);
+        for (int by = 0; by < CHUNK_SIZE; by++)
+            for (int bz = 0; bz < CHUNK_SIZE; bz++)
+                for (int bx = 0; bx < CHUNK_SIZE; bx++)
+                    blocks.push_back(chunk.Position * CHUNK_SIZE + glm::ivec3(bx, by, bz));
+    }
+    std::vector<float> exact(blocks.size());
+    start = std::chrono::high_resolution_clock::now();
+    generator.Density(blocks.data(), exact.data(), blocks.size());
+    end = std::chrono::high_resolution_clock::now();
+    double denseMs = BenchmarkMs(start, end);
+    size_t differing = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const Chunk& chunk = *compared[i / CHUNK_VOLUME];
+        glm::ivec3 local = blocks[i] - chunk.Position * CHUNK_SIZE;
+        differing += (exact[i] > 0.0f) != (chunk.Get(local.x, local.y, local.z) != BLOCK_AIR);
+    }
+
+#if defined(__AVX2__)
+    const char* path = "AVX2";
+#else
+    const char* path = "scalar";
+#endif
+    std::cout << "BENCHMARK::TERRAIN_GENERATION " << serial.size() << " chunks, " << jobs.WorkerCount() << " workers, " << solid << " solid blocks" << std::endl;
+    std::cout << "  fractal noise, 4 octaves: scalar " << scalarMs * 1e6 / points << " ns, batched (" << path << ") " << batchMs * 1e6 / points
+        << " ns per point (" << scalarMs / batchMs << "x), max difference " << maxError << std::endl;
+    std::cout << "  one thread: " << serialMs << " ms (" << serial.size() / (serialMs / 1000.0) << " chunks/s), jobs: " << parallelMs << " ms ("
+        << parallel.size() / (parallelMs / 1000.0) << " chunks/s, " << serialMs / parallelMs << "x), " << mismatched << " sections differ" << std::endl;
+    std::cout << "  per-block noise for " << compared.size() << " surface chunks: " << denseMs / compared.size() << " ms per chunk, "
+        << 100.0 * differing / std::max<size_t>(blocks.size(), 1) << "% of blocks change solidity against the lattice" << std::endl;
+}
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <iostream>
+
+#include "stb_image.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Default texture cache values
+const uint32_t TEXTURE_CACHE_MAX_DIMENSION = 32768;     // entries claiming a larger width or height are taken as corrupt
+
+
+// Options that change the decoded pixels. They are part of the cache key, so changing any of them produces a new cache entry
+struct TextureLoadOptions {
+    int desiredChannels = 0;        // 0 keeps the channel count stored in the file
+    bool flipVertically = false;
+    bool buildMipChain = false;     // store the full box-filtered mip chain instead of only level 0
+};
+
+
+// Read-only memory mapping of a whole file. Used so warm starts hand the cached pixels straight to glTexImage2D without a copy
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path)
+    {
+        Close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+            Close();
+            return false;
+        }
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL) {
+            Close();
+            return false;
+        }
+        data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        fileDescriptor = open(path.c_str(), O_RDONLY);
+        if (fileDescriptor < 0)
+            return false;
+        struct stat fileStat;
+        if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+            Close();
+            return false;
+        }
+        void* mapping = mmap(NULL, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        data = mapping == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(mapping);
+        size = static_cast<size_t>(fileStat.st_size);
+#endif
+        if (data == nullptr) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mappingHandle != NULL)
+            CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+        mappingHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap(const_cast<unsigned char*>(data), size);
+        if (fileDescriptor >= 0)
+            close(fileDescriptor);
+        fileDescriptor = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    int fileDescriptor = -1;
+#endif
+};
+
+
+// Decoded pixels of one image, either borrowed from a cache file mapping (warm start) or owned in memory (cold start)
+class CachedImage
+{
+public:
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int levels = 0;
+
+    bool Valid() const { return levels > 0; }
+
+    int LevelWidth(int level) const { return std::max(1, width >> level); }
+    int LevelHeight(int level) const { return std::max(1, height >> level); }
+    size_t LevelSize(int level) const { return static_cast<size_t>(LevelWidth(level)) * LevelHeight(level) * channels; }
+    const unsigned char* LevelData(int level) const { return pixels + levelOffsets[level]; }
+
+    // total bytes of every stored level, i.e. what the GPU copy will roughly cost
+    size_t TotalSize() const
+    {
+        size_t total = 0;
+        for (int level = 0; level < levels; level++)
+            total += LevelSize(level);
+        return total;
+    }
+
+private:
+    friend class TextureCache;
+
+    const unsigned char* pixels = nullptr;
+    std::vector<size_t> levelOffsets;
+    std::vector<unsigned char> ownedPixels;
+    MappedFile mapping;
+};
+
+
+// Disk cache of stb_image decode results. Entries are keyed by a hash of the source file contents and the decode options, and
+// are memory mapped on later runs so the JPEG/PNG decode is skipped entirely
+class TextureCache
+{
+public:
+    // cumulative statistics
+    unsigned int Hits = 0;
+    unsigned int Misses = 0;
+
+    TextureCache(const std::string& directory) : cacheDirectory(directory)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+    }
+
+    // loads path into image, decoding and writing a cache entry only if no valid entry exists yet
+    bool Load(const std::string& path, const TextureLoadOptions& options, CachedImage& image)
+    {
+        std::ifstream sourceFile(path, std::ios::binary);
+        if (!sourceFile)
+            return false;
+        std::vector<unsigned char> source((std::istreambuf_iterator<char>(sourceFile)), std::istreambuf_iterator<char>());
+
+        uint64_t sourceHash = hashBytes(source.data(), source.size());
+        std::string entryPath = entryPathFor(sourceHash, options);
+
+        if (loadEntry(entryPath, sourceHash, image)) {
+            Hits++;
+            return true;
+        }
+
+        Misses++;
+        if (!decode(source, options, image))
+            return false;
+        writeEntry(entryPath, sourceHash, image);
+        return true;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x31435854; // "TXC1"
+    static const uint32_t VERSION = 1;
+
+    struct EntryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+        uint32_t levels;
+    };
+
+    std::string cacheDirectory;
+
+    // 64-bit FNV-1a, plenty to tell source files apart
+    static uint64_t hashBytes(const unsigned char* bytes, size_t count, uint64_t hash = 14695981039346656037ull)
+    {
+        for (size_t i = 0; i < count; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string entryPathFor(uint64_t sourceHash, const TextureLoadOptions& options) const
+    {
+        unsigned char optionBytes[3] = { (unsigned char)options.desiredChannels, (unsigned char)options.flipVertically, (unsigned char)options.buildMipChain };
+        uint64_t key = hashBytes(optionBytes, sizeof(optionBytes), sourceHash);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)key);
+        return (std::filesystem::path(cacheDirectory) / name).string();
+    }
+
+    static void computeLevelOffsets(CachedImage& image)
+    {
+        image.levelOffsets.resize(image.levels);
+        size_t offset = 0;
+        for (int level = 0; level < image.levels; level++) {
+            image.levelOffsets[level] = offset;
+            offset += image.LevelSize(level);
+        }
+    }
+
+    // dimensions in range, 1 to 4 channels and no more levels than the full mip chain
+    static bool validHeader(const EntryHeader& header)
+    {
+        if (header.width == 0 || header.height == 0 || header.width > TEXTURE_CACHE_MAX_DIMENSION || header.height > TEXTURE_CACHE_MAX_DIMENSION)
+            return false;
+        if (header.channels < 1 || header.channels > 4)
+            return false;
+        uint32_t fullChain = 1;
+        while ((header.width >> fullChain) > 0 || (header.height >> fullChain) > 0)
+            fullChain++;
+        return header.levels >= 1 && header.levels <= fullChain;
+    }
+
+    bool loadEntry(const std::string& entryPath, uint64_t sourceHash, CachedImage& image)
+    {
+        if (!image.mapping.Open(entryPath))
+            return false;
+
+        EntryHeader header;
+        if (image.mapping.Size() < sizeof(header)) {
+            image.mapping.Close();
+            return false;
+        }
+        std::memcpy(&header, image.mapping.Data(), sizeof(header));
+        if (header.magic != MAGIC || header.version != VERSION || header.sourceHash != sourceHash) {
+            image.mapping.Close();
+            return false;
+        }
+
+        // the header is used in shifts and sizes below, so a corrupt one is a miss before anything is computed from it
+        if (!validHeader(header)) {
+            image.mapping.Close();
+            return false;
+        }
+
+        image.width = header.width;
+        image.height = header.height;
+        image.channels = header.channels;
+        image.levels = header.levels;
+        computeLevelOffsets(image);
+
+        // a truncated entry (e.g. crash while writing) is treated as a miss and rewritten
+        if (image.mapping.Size() != sizeof(header) + image.TotalSize()) {
+            image.mapping.Close();
+            image.levels = 0;
+            return false;
+        }
+
+        image.pixels = image.mapping.Data() + sizeof(header);
+        return true;
+    }
+
+    static bool decode(const std::vector<unsigned char>& source, const TextureLoadOptions& options, CachedImage& image)
+    {
+        int width, height, fileChannels;
+        stbi_set_flip_vertically_on_load(options.flipVertically);
+        unsigned char* data = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &fileChannels, options.desiredChannels);
+        stbi_set_flip_vertically_on_load(false);
+        if (!data)
+            return false;
+
+        image.width = width;
+        image.height = height;
+        image.channels = options.desiredChannels != 0 ? options.desiredChannels : fileChannels;
+        image.levels = 1;
+        if (options.buildMipChain) {
+            while ((width >> image.levels) > 0 || (height >> image.levels) > 0)
+                image.levels++;
+        }
+        computeLevelOffsets(image);
+
+        image.ownedPixels.resize(image.TotalSize());
+        std::memcpy(image.ownedPixels.data(), data, image.LevelSize(0));
+        stbi_image_free(data);
+
+        for (int level = 1; level < image.levels; level++)
+            downsample(image, level);
+
+        image.pixels = image.ownedPixels.data();
+        return true;
+    }
+
+    // 2x2 box filter from level - 1, clamping at the edge for odd sizes
+    static void downsample(CachedImage& image, int level)
+    {
+        const unsigned char* src = image.ownedPixels.data() + image.levelOffsets[level - 1];
+        unsigned char* dst = image.ownedPixels.data() + image.levelOffsets[level];
+        int srcWidth = image.LevelWidth(level - 1);
+        int srcHeight = image.LevelHeight(level - 1);
+        int channels = image.channels;
+
+        for (int y = 0; y < image.LevelHeight(level); y++) {
+            int y0 = std::min(y * 2, srcHeight - 1);
+            int y1 = std::min(y * 2 + 1, srcHeight - 1);
+            for (int x = 0; x < image.LevelWidth(level); x++) {
+                int x0 = std::min(x * 2, srcWidth - 1);
+                int x1 = std::min(x * 2 + 1, srcWidth - 1);
+                for (int c = 0; c < channels; c++) {
+                    int sum = src[(y0 * srcWidth + x0) * channels + c] + src[(y0 * srcWidth + x1) * channels + c]
+                            + src[(y1 * srcWidth + x0) * channels + c] + src[(y1 * srcWidth + x1) * channels + c];
+                    *dst++ = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    // writes to a temporary name first so a half written file is never picked up by another run
+    static void writeEntry(const std::string& entryPath, uint64_t sourceHash, const CachedImage& image)
+    {
+        EntryHeader header = { MAGIC, VERSION, sourceHash, (uint32_t)image.width, (uint32_t)image.height, (uint32_t)image.channels, (uint32_t)image.levels };
+
+        std::string tempPath = entryPath + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return;
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(image.ownedPixels.data()), image.TotalSize());
+            if (!out) {
+                std::cout << "ERROR::TEXTURE_CACHE::WRITE_FAILED " << entryPath << std::endl;
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, entryPath, error);
+        if (error)
+            std::filesystem::remove(tempPath, error);
+    }
+};
+
+#endif
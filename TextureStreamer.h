@@ -0,0 +1,221 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "Camera.h"
+#include "TextureCache.h"
+
+// Default streaming values
+const size_t STREAM_VRAM_BUDGET = 64 * 1024 * 1024;     // bytes of mip data allowed to be resident
+const size_t STREAM_UPLOAD_BUDGET = 2 * 1024 * 1024;    // bytes uploaded per Update() call
+const int STREAM_RESIDENT_SIZE = 64;                    // levels at or below this size are uploaded up front and never evicted
+const unsigned long STREAM_STALE_FRAMES = 120;          // frames a fine level stays resident after it was last needed
+
+
+// Keeps a texture's mip chain partly resident on the GPU. The smallest mips are uploaded when the texture is added, the finer ones
+// are streamed in as objects using it grow on screen, and the least recently needed fine mips are dropped when the budget is hit or
+// once nothing has needed them for STREAM_STALE_FRAMES frames.
+//
+// GL 3.3 has no sparse textures, so residency is expressed with GL_TEXTURE_BASE_LEVEL: levels below the base are respecified as
+// 0x0 images to give their storage back, and the sampler only ever sees the resident part of the chain.
+class TextureStreamer
+{
+public:
+    size_t VramBudget;
+    size_t UploadBudget;
+
+    // cumulative statistics
+    unsigned int LevelsUploaded = 0;
+    unsigned int LevelsEvicted = 0;
+
+    TextureStreamer(size_t vramBudget = STREAM_VRAM_BUDGET, size_t uploadBudget = STREAM_UPLOAD_BUDGET) : VramBudget(vramBudget), UploadBudget(uploadBudget)
+    {
+    }
+
+    ~TextureStreamer()
+    {
+        for (StreamedTexture& texture : textures)
+            glDeleteTextures(1, &texture.id);
+    }
+
+    // takes ownership of image (which must outlive streaming, so the cache mapping is kept open) and uploads its coarsest mips
+    int Add(std::unique_ptr<CachedImage> image)
+    {
+        StreamedTexture texture;
+        texture.image = std::move(image);
+        const CachedImage& pixels = *texture.image;
+
+        texture.format = pixels.channels == 4 ? GL_RGBA : pixels.channels == 3 ? GL_RGB : pixels.channels == 2 ? GL_RG : GL_RED;
+        texture.lastNeeded.assign(pixels.levels, 0);
+
+        // the always-resident tail: every level no larger than STREAM_RESIDENT_SIZE, or at least the last one
+        texture.minResidentBase = pixels.levels - 1;
+        while (texture.minResidentBase > 0 && std::max(pixels.LevelWidth(texture.minResidentBase - 1), pixels.LevelHeight(texture.minResidentBase - 1)) <= STREAM_RESIDENT_SIZE)
+            texture.minResidentBase--;
+        texture.residentBase = pixels.levels;
+        texture.desiredBase = texture.minResidentBase;
+
+        glGenTextures(1, &texture.id);
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pixels.levels - 1);
+
+        // smallest first, so the texture is complete (and sampleable) after the very first upload
+        while (texture.residentBase > texture.minResidentBase)
+            uploadLevel(texture, texture.residentBase - 1);
+
+        textures.push_back(std::move(texture));
+        return (int)textures.size() - 1;
+    }
+
+    // 0 for the handle of a texture that failed to load (-1), so binding it just samples black like an empty texture
+    unsigned int TextureID(int handle) const
+    {
+        return handle >= 0 ? textures[handle].id : 0;
+    }
+
+    // bytes of mip data on the GPU, what the budget is checked against
+    size_t ResidentBytes() const { return residentBytes; }
+
+    // finest level currently sampleable, -1 for the handle of a texture that failed to load
+    int ResidentLevel(int handle) const
+    {
+        return handle >= 0 ? textures[handle].residentBase : -1;
+    }
+
+    // records that an object of worldSize units centred at center is drawn with the texture this frame. The needed level is the one
+    // whose texel count roughly matches the object's projected height in pixels
+    void Request(int handle, const Camera& camera, glm::vec3 center, float worldSize, int screenHeight)
+    {
+        if (handle < 0)
+            return;
+        StreamedTexture& texture = textures[handle];
+        const CachedImage& pixels = *texture.image;
+
+        float distance = std::max(glm::length(center - camera.Position), 0.001f);
+        float projectedPixels = worldSize * (float)screenHeight / (2.0f * distance * std::tan(glm::radians(camera.Zoom) * 0.5f));
+        float texels = (float)std::max(pixels.width, pixels.height);
+
+        int level = projectedPixels >= texels ? 0 : (int)std::floor(std::log2(texels / std::max(projectedPixels, 1.0f)));
+        level = std::min(level, texture.minResidentBase);
+
+        texture.desiredBase = std::min(texture.desiredBase, level);
+        for (int l = level; l < pixels.levels; l++)
+            texture.lastNeeded[l] = frame;
+    }
+
+    // streams in (and if needed evicts) mips according to this frame's requests. Call once per frame after all Request calls
+    void Update()
+    {
+        size_t uploaded = 0;
+
+        // fine levels nothing has asked for in a while go back, even while the budget has room
+        for (StreamedTexture& texture : textures) {
+            while (texture.residentBase < texture.minResidentBase && texture.desiredBase > texture.residentBase
+                && frame - texture.lastNeeded[texture.residentBase] > STREAM_STALE_FRAMES)
+                evictLevel(texture);
+        }
+
+        while (uploaded < UploadBudget) {
+            // the texture furthest from its wanted detail gets the next level
+            StreamedTexture* best = nullptr;
+            for (StreamedTexture& texture : textures) {
+                if (texture.desiredBase < texture.residentBase && (best == nullptr || texture.residentBase - texture.desiredBase > best->residentBase - best->desiredBase))
+                    best = &texture;
+            }
+            if (best == nullptr)
+                break;
+
+            int level = best->residentBase - 1;
+            size_t levelSize = best->image->LevelSize(level);
+            if (!makeRoom(levelSize))
+                break;
+
+            uploadLevel(*best, level);
+            uploaded += levelSize;
+        }
+
+        // requests are rebuilt from scratch every frame
+        for (StreamedTexture& texture : textures)
+            texture.desiredBase = texture.minResidentBase;
+        frame++;
+    }
+
+private:
+    struct StreamedTexture {
+        unsigned int id = 0;
+        GLenum format = GL_RGB;
+        std::unique_ptr<CachedImage> image;
+        int residentBase = 0;               // finest resident level; every coarser level is resident too
+        int minResidentBase = 0;            // levels from here down are never evicted
+        int desiredBase = 0;                // finest level requested this frame
+        std::vector<unsigned long> lastNeeded; // frame each level was last requested in
+    };
+
+    std::vector<StreamedTexture> textures;
+    unsigned long frame = 1;
+    size_t residentBytes = 0;
+
+    void uploadLevel(StreamedTexture& texture, int level)
+    {
+        const CachedImage& pixels = *texture.image;
+
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, texture.format, pixels.LevelWidth(level), pixels.LevelHeight(level), 0, texture.format, GL_UNSIGNED_BYTE, pixels.LevelData(level));
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+        texture.residentBase = level;
+        residentBytes += pixels.LevelSize(level);
+        LevelsUploaded++;
+    }
+
+    void evictLevel(StreamedTexture& texture)
+    {
+        int level = texture.residentBase;
+
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+        glTexImage2D(GL_TEXTURE_2D, level, texture.format, 0, 0, 0, texture.format, GL_UNSIGNED_BYTE, NULL);
+
+        texture.residentBase = level + 1;
+        residentBytes -= texture.image->LevelSize(level);
+        LevelsEvicted++;
+    }
+
+    // evicts the least recently needed finest levels until bytes fit into the budget, the requester's own stale levels included.
+    // Levels needed this frame are never evicted, so a budget that is simply too small stops streaming instead of thrashing
+    bool makeRoom(size_t bytes)
+    {
+        while (residentBytes + bytes > VramBudget) {
+            StreamedTexture* victim = nullptr;
+            unsigned long oldest = frame;
+            for (StreamedTexture& texture : textures) {
+                if (texture.residentBase >= texture.minResidentBase)
+                    continue;
+                unsigned long lastNeeded = texture.lastNeeded[texture.residentBase];
+                if (lastNeeded < oldest) {
+                    oldest = lastNeeded;
+                    victim = &texture;
+                }
+            }
+            if (victim == nullptr)
+                return false;
+            evictLevel(*victim);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Benchmark.h"
+
+
+// Position/rotation/scale of many objects stored as separate arrays (SoA), so model matrices can be composed 8 at a time.
+// Composition builds T * R * S directly from the quaternion instead of going through glm::translate and glm::rotate, which
+// rebuild an axis-angle matrix and do a full mat4 multiply per object.
+class TransformSystem
+{
+public:
+    // adds an object and returns its index
+    size_t Add(glm::vec3 position, glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3 scale = glm::vec3(1.0f))
+    {
+        size_t index = count++;
+        for (std::vector<float>* component : components())
+            component->resize(count, 0.0f);
+
+        SetPosition(index, position);
+        SetRotation(index, rotation);
+        SetScale(index, scale);
+        return index;
+    }
+
+    size_t Count() const { return count; }
+
+    void SetPosition(size_t index, glm::vec3 position)
+    {
+        px[index] = position.x;
+        py[index] = position.y;
+        pz[index] = position.z;
+    }
+
+    glm::vec3 GetPosition(size_t index) const
+    {
+        return glm::vec3(px[index], py[index], pz[index]);
+    }
+
+    void SetRotation(size_t index, glm::quat rotation)
+    {
+        rotation = glm::normalize(rotation);
+        qx[index] = rotation.x;
+        qy[index] = rotation.y;
+        qz[index] = rotation.z;
+        qw[index] = rotation.w;
+    }
+
+    // same convention as glm::rotate: angle in radians around axis (which does not need to be normalized)
+    void SetRotation(size_t index, float angle, glm::vec3 axis)
+    {
+        SetRotation(index, glm::angleAxis(angle, glm::normalize(axis)));
+    }
+
+    void SetScale(size_t index, glm::vec3 scale)
+    {
+        sx[index] = scale.x;
+        sy[index] = scale.y;
+        sz[index] = scale.z;
+    }
+
+    // writes the model matrix of every object to out, which must hold Count() matrices
+    void Compose(glm::mat4* out) const
+    {
+        size_t index = 0;
+#if defined(__AVX2__)
+        for (; index + 8 <= count; index += 8)
+            composeBatch(index, out + index);
+#endif
+        // scalar remainder (or everything, without AVX2)
+        for (; index < count; index++)
+            out[index] = composeOne(index);
+    }
+
+private:
+    size_t count = 0;
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+
+    std::vector<std::vector<float>*> components()
+    {
+        return { &px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz };
+    }
+
+    glm::mat4 composeOne(size_t i) const
+    {
+        float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+        float xx = x * x, yy = y * y, zz = z * z;
+        float xy = x * y, xz = x * z, yz = y * z;
+        float wx = w * x, wy = w * y, wz = w * z;
+
+        glm::mat4 m;
+        m[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * sx[i];
+        m[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * sy[i];
+        m[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * sz[i];
+        m[3] = glm::vec4(px[i], py[i], pz[i], 1.0f);
+        return m;
+    }
+
+#if defined(__AVX2__)
+    // in-register 8x8 transpose, turns 8 "one matrix element for 8 objects" rows into 8 "8 elements of one object" rows
+    static void transpose8(__m256 r[8])
+    {
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+        __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+        r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+        r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+        r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+        r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+        r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+    }
+
+    void composeBatch(size_t i, glm::mat4* out) const
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 x = _mm256_loadu_ps(&qx[i]);
+        __m256 y = _mm256_loadu_ps(&qy[i]);
+        __m256 z = _mm256_loadu_ps(&qz[i]);
+        __m256 w = _mm256_loadu_ps(&qw[i]);
+
+        __m256 x2 = _mm256_mul_ps(x, two), y2 = _mm256_mul_ps(y, two), z2 = _mm256_mul_ps(z, two);
+        __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+        __m256 scaleX = _mm256_loadu_ps(&sx[i]);
+        __m256 scaleY = _mm256_loadu_ps(&sy[i]);
+        __m256 scaleZ = _mm256_loadu_ps(&sz[i]);
+
+        // first half of each matrix: columns 0 and 1
+        __m256 rows[8];
+        rows[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), scaleX);
+        rows[1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), scaleX);
+        rows[2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), scaleX);
+        rows[3] = zero;
+        rows[4] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), scaleY);
+        rows[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), scaleY);
+        rows[6] = _mm256_mul_ps(_mm256_add_ps(yz, wx), scaleY);
+        rows[7] = zero;
+        transpose8(rows);
+        for (int k = 0; k < 8; k++)
+            _mm256_storeu_ps(&out[k][0][0], rows[k]);
+
+        // second half: column 2 and the translation
+        rows[0] = _mm256_mul_ps(_mm256_add_ps(xz, wy), scaleZ);
+        rows[1] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), scaleZ);
+        rows[2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), scaleZ);
+        rows[3] = zero;
+        rows[4] = _mm256_loadu_ps(&px[i]);
+        rows[5] = _mm256_loadu_ps(&py[i]);
+        rows[6] = _mm256_loadu_ps(&pz[i]);
+        rows[7] = one;
+        transpose8(rows);
+        for (int k = 0; k < 8; k++)
+            _mm256_storeu_ps(&out[k][2][0], rows[k]);
+    }
+#endif
+};
+
+
+// Times the per-object glm::translate + glm::rotate path against TransformSystem::Compose for count objects and prints both
+inline void BenchmarkTransforms(size_t count, int iterations)
+{
+    std::vector<glm::vec3> positions(count);
+    std::vector<glm::vec3> axes(count);
+    std::vector<float> angles(count);
+    TransformSystem transforms;
+    for (size_t i = 0; i < count; i++) {
+        positions[i] = glm::vec3((float)(i % 100), (float)(i / 100 % 100), -(float)(i / 10000));
+        axes[i] = glm::vec3(1.0f, 0.3f + (float)(i % 7) * 0.1f, 0.5f);
+        angles[i] = (float)i * 0.01f;
+        transforms.Add(positions[i]);
+        transforms.SetRotation(i, angles[i], axes[i]);
+    }
+
+    std::vector<glm::mat4> glmMatrices(count);
+    std::vector<glm::mat4> batchMatrices(count);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (size_t i = 0; i < count; i++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+            glmMatrices[i] = glm::rotate(model, angles[i], axes[i]);
+        }
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++)
+        transforms.Compose(batchMatrices.data());
+    auto end = std::chrono::high_resolution_clock::now();
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                maxError = glm::max(maxError, glm::abs(glmMatrices[i][c][r] - batchMatrices[i][c][r]));
+
+    double glmMs = BenchmarkMs(start, middle) / iterations;
+    double batchMs = BenchmarkMs(middle, end) / iterations;
+#if defined(__AVX2__)
+    const char* path = "AVX2";
+#else
+    const char* path = "scalar";
+#endif
+    std::cout << "BENCHMARK::TRANSFORMS " << count << " objects" << std::endl;
+    std::cout << "  glm translate+rotate: " << glmMs << " ms" << std::endl;
+    std::cout << "  SoA compose (" << path << "): " << batchMs << " ms (" << glmMs / batchMs << "x), max error " << maxError << std::endl;
+}
+
+#endif
@@ -0,0 +1,472 @@
+#ifndef VOXEL_CHUNK_H
+#define VOXEL_CHUNK_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Benchmark.h"
+
+// Default voxel storage values
+const int SECTION_SIZE = 16;                                            // blocks along each side of a section
+const int SECTION_VOLUME = SECTION_SIZE * SECTION_SIZE * SECTION_SIZE;
+const int CHUNK_SECTIONS = 2;                                           // sections along each side of a chunk
+const int CHUNK_SIZE = SECTION_SIZE * CHUNK_SECTIONS;                   // blocks along each side of a chunk
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Block ids, 0 is always air
+typedef uint16_t BlockId;
+
+enum Block_Type : BlockId {
+    BLOCK_AIR = 0,
+    BLOCK_STONE,
+    BLOCK_DIRT,
+    BLOCK_GRASS,
+    BLOCK_SAND,
+    BLOCK_WOOD,
+    BLOCK_LEAVES,
+    BLOCK_ORE,
+    BLOCK_TYPE_COUNT
+};
+
+
+// 16x16x16 blocks stored as indices into a palette of the block ids that actually occur in the section.
+// Indices are bit packed into 64-bit words with 0, 1, 2, 4, 8 or 16 bits per block (powers of two, so no index straddles two
+// words). A section of a single block type (all air, solid stone, ...) has a one entry palette and no index data at all.
+// The width grows when a new id doesn't fit the palette and shrinks again once enough ids disappeared; every palette entry
+// keeps a count of the blocks using it, so both cases are noticed without scanning the section.
+class ChunkSection
+{
+public:
+    ChunkSection(BlockId fill = BLOCK_AIR)
+    {
+        Fill(fill);
+    }
+
+    static int Index(int x, int y, int z) { return (y * SECTION_SIZE + z) * SECTION_SIZE + x; }
+
+    BlockId Get(int x, int y, int z) const
+    {
+        return palette[readIndex(Index(x, y, z))];
+    }
+
+    void Set(int x, int y, int z, BlockId block)
+    {
+        if (setIndex(Index(x, y, z), block))
+            narrowIfSparse();
+    }
+
+    // sets every block of the section and drops all index data
+    void Fill(BlockId block)
+    {
+        palette.assign(1, block);
+        counts.assign(1, SECTION_VOLUME);
+        bitsPerEntry = 0;
+        data.clear();
+        data.shrink_to_fit();
+    }
+
+    // sets the blocks in [min, max] (section local, inclusive)
+    void FillBox(const glm::ivec3& min, const glm::ivec3& max, BlockId block)
+    {
+        if (min == glm::ivec3(0) && max == glm::ivec3(SECTION_SIZE - 1)) {
+            Fill(block);
+            return;
+        }
+
+        bool removed = false;
+        for (int y = min.y; y <= max.y; y++)
+            for (int z = min.z; z <= max.z; z++)
+                for (int x = min.x; x <= max.x; x++)
+                    removed |= setIndex(Index(x, y, z), block);
+        if (removed)
+            narrowIfSparse();
+    }
+
+    // replaces every block with in (Index order), building the palette and packing the indices in one pass instead of a Set
+    // per block
+    void Encode(const BlockId* in)
+    {
+        // counts are added up per run of equal ids and words are assembled in a register, a read-modify-write through
+        // memory for every block would be most of the time
+        uint16_t indices[SECTION_VOLUME];
+        palette.assign(1, in[0]);
+        counts.assign(1, 0);
+        BlockId last = in[0];
+        unsigned int entry = 0, run = 0;
+        for (int i = 0; i < SECTION_VOLUME; i++) {
+            if (in[i] != last) {
+                counts[entry] += (uint16_t)run;
+                run = 0;
+                last = in[i];
+                entry = (unsigned int)(std::find(palette.begin(), palette.end(), last) - palette.begin());
+                if (entry == palette.size()) {
+                    palette.push_back(last);
+                    counts.push_back(0);
+                }
+            }
+            indices[i] = (uint16_t)entry;
+            run++;
+        }
+        counts[entry] += (uint16_t)run;
+
+        bitsPerEntry = requiredBits((int)palette.size());
+        data.resize(wordCount(bitsPerEntry));
+        if (bitsPerEntry == 0) {
+            data.shrink_to_fit();
+            return;
+        }
+        int perWord = 64 / bitsPerEntry;
+        const uint16_t* index = indices;
+        for (size_t w = 0; w < data.size(); w++) {
+            uint64_t word = 0;
+            for (int i = 0; i < perWord; i++)
+                word |= (uint64_t)*index++ << (i * bitsPerEntry);
+            data[w] = word;
+        }
+    }
+
+    // writes all blocks to out in Index order, much faster than Get for every block
+    void Decode(BlockId* out) const
+    {
+        if (bitsPerEntry == 0) {
+            std::fill(out, out + SECTION_VOLUME, palette[0]);
+            return;
+        }
+        uint64_t mask = (1ull << bitsPerEntry) - 1;
+        int perWord = 64 / bitsPerEntry;
+        for (size_t w = 0; w < data.size(); w++) {
+            uint64_t word = data[w];
+            for (int i = 0; i < perWord; i++, word >>= bitsPerEntry)
+                *out++ = palette[word & mask];
+        }
+    }
+
+    bool IsUniform() const { return bitsPerEntry == 0; }
+    int BitsPerEntry() const { return bitsPerEntry; }
+
+    // distinct block ids currently in the section
+    int PaletteSize() const
+    {
+        int used = 0;
+        for (uint16_t count : counts)
+            used += count > 0;
+        return used;
+    }
+
+    int NonAirCount() const
+    {
+        int air = 0;
+        for (size_t i = 0; i < palette.size(); i++) {
+            if (palette[i] == BLOCK_AIR)
+                air += counts[i];
+        }
+        return SECTION_VOLUME - air;
+    }
+
+    size_t MemoryUsage() const
+    {
+        return sizeof(ChunkSection) + palette.capacity() * sizeof(BlockId) + counts.capacity() * sizeof(uint16_t) + data.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    std::vector<BlockId> palette;       // palette index -> block id, entries with a zero count are free
+    std::vector<uint16_t> counts;       // blocks using each palette entry
+    std::vector<uint64_t> data;         // packed palette indices, empty when bitsPerEntry is 0
+    int bitsPerEntry = 0;
+
+    static size_t wordCount(int bits) { return (size_t)SECTION_VOLUME * bits / 64; }
+
+    unsigned int readIndex(int index) const
+    {
+        if (bitsPerEntry == 0)
+            return 0;
+        unsigned int bit = (unsigned int)index * bitsPerEntry;
+        uint64_t mask = (1ull << bitsPerEntry) - 1;
+        return (unsigned int)((data[bit >> 6] >> (bit & 63)) & mask);
+    }
+
+    void writeIndex(int index, unsigned int value)
+    {
+        unsigned int bit = (unsigned int)index * bitsPerEntry;
+        uint64_t mask = (1ull << bitsPerEntry) - 1;
+        uint64_t& word = data[bit >> 6];
+        word = (word & ~(mask << (bit & 63))) | ((uint64_t)value << (bit & 63));
+    }
+
+    // palette index of block, adding it (and widening the indices if needed) when it isn't there yet
+    unsigned int paletteIndex(BlockId block)
+    {
+        int freeSlot = -1;
+        for (size_t i = 0; i < palette.size(); i++) {
+            if (counts[i] > 0 && palette[i] == block)
+                return (unsigned int)i;
+            if (counts[i] == 0 && freeSlot < 0)
+                freeSlot = (int)i;
+        }
+        if (freeSlot >= 0) {
+            palette[freeSlot] = block;
+            return (unsigned int)freeSlot;
+        }
+
+        if (palette.size() >= (size_t)1 << bitsPerEntry)
+            repack(bitsPerEntry == 0 ? 1 : bitsPerEntry * 2, false);
+        palette.push_back(block);
+        counts.push_back(0);
+        return (unsigned int)palette.size() - 1;
+    }
+
+    // returns true when a palette entry lost its last block
+    bool setIndex(int index, BlockId block)
+    {
+        unsigned int old = readIndex(index);
+        if (palette[old] == block)
+            return false;
+
+        // may widen, which keeps every index as it is
+        unsigned int entry = paletteIndex(block);
+        writeIndex(index, entry);
+        counts[entry]++;
+        counts[old]--;
+        return counts[old] == 0;
+    }
+
+    // shrinks the indices once the used entries fit in half the palette of the next smaller width, so a section hovering
+    // around a width boundary doesn't repack on every Set
+    void narrowIfSparse()
+    {
+        if (bitsPerEntry == 0)
+            return;
+        int used = PaletteSize();
+        int smaller = bitsPerEntry == 1 ? 0 : bitsPerEntry / 2;
+        if (used <= std::max(1, (1 << smaller) / 2))
+            repack(requiredBits(used), true);
+    }
+
+    static int requiredBits(int entries)
+    {
+        int bits = 0;
+        while ((1 << bits) < entries)
+            bits = bits == 0 ? 1 : bits * 2;
+        return bits;
+    }
+
+    // rewrites the indices with a new width. compact drops the free palette entries and renumbers the rest
+    void repack(int bits, bool compact)
+    {
+        std::vector<unsigned int> remap(palette.size());
+        std::vector<BlockId> newPalette;
+        std::vector<uint16_t> newCounts;
+        for (size_t i = 0; i < palette.size(); i++) {
+            if (compact && counts[i] == 0)
+                continue;
+            remap[i] = (unsigned int)newPalette.size();
+            newPalette.push_back(palette[i]);
+            newCounts.push_back(counts[i]);
+        }
+
+        std::vector<uint64_t> newData(wordCount(bits));
+        if (bits > 0) {
+            uint64_t mask = (1ull << bits) - 1;
+            for (int i = 0; i < SECTION_VOLUME; i++) {
+                unsigned int bit = (unsigned int)i * bits;
+                newData[bit >> 6] |= ((uint64_t)remap[readIndex(i)] & mask) << (bit & 63);
+            }
+        }
+
+        palette.swap(newPalette);
+        counts.swap(newCounts);
+        data.swap(newData);
+        bitsPerEntry = bits;
+    }
+};
+
+
+// Hash for chunk positions as unordered_map keys
+struct ChunkPositionHash {
+    size_t operator()(const glm::ivec3& position) const
+    {
+        return (size_t)((uint32_t)position.x * 73856093u ^ (uint32_t)position.y * 19349663u ^ (uint32_t)position.z * 83492791u);
+    }
+};
+
+
+// A 32x32x32 cube of the world made of 2x2x2 sections, addressed with chunk local coordinates.
+// Position is the chunk's coordinate in chunk units, so block (x, y, z) of the chunk is at Position * CHUNK_SIZE + (x, y, z).
+// Every change bumps Version, which is how meshes built from an older copy of the blocks are recognized.
+class Chunk
+{
+public:
+    glm::ivec3 Position;
+
+    Chunk(const glm::ivec3& position = glm::ivec3(0)) : Position(position)
+    {
+    }
+
+    BlockId Get(int x, int y, int z) const
+    {
+        return sections[sectionIndex(x, y, z)].Get(x % SECTION_SIZE, y % SECTION_SIZE, z % SECTION_SIZE);
+    }
+
+    unsigned int Version() const { return version; }
+
+    void Set(int x, int y, int z, BlockId block)
+    {
+        version++;
+        sections[sectionIndex(x, y, z)].Set(x % SECTION_SIZE, y % SECTION_SIZE, z % SECTION_SIZE, block);
+    }
+
+    void Fill(BlockId block)
+    {
+        version++;
+        for (ChunkSection& section : sections)
+            section.Fill(block);
+    }
+
+    // sets the blocks in [min, max] (chunk local, inclusive, clamped to the chunk)
+    void FillBox(glm::ivec3 min, glm::ivec3 max, BlockId block)
+    {
+        min = glm::max(min, glm::ivec3(0));
+        max = glm::min(max, glm::ivec3(CHUNK_SIZE - 1));
+        if (glm::any(glm::greaterThan(min, max)))
+            return;
+
+        version++;
+        for (int sy = 0; sy < CHUNK_SECTIONS; sy++)
+            for (int sz = 0; sz < CHUNK_SECTIONS; sz++)
+                for (int sx = 0; sx < CHUNK_SECTIONS; sx++) {
+                    glm::ivec3 origin = glm::ivec3(sx, sy, sz) * SECTION_SIZE;
+                    glm::ivec3 localMin = glm::max(min - origin, glm::ivec3(0));
+                    glm::ivec3 localMax = glm::min(max - origin, glm::ivec3(SECTION_SIZE - 1));
+                    if (glm::all(glm::lessThanEqual(localMin, localMax)))
+                        sections[(sy * CHUNK_SECTIONS + sz) * CHUNK_SECTIONS + sx].FillBox(localMin, localMax, block);
+                }
+    }
+
+    // replaces every block, blocks holds CHUNK_VOLUME ids at (y * CHUNK_SIZE + z) * CHUNK_SIZE + x
+    void Load(const BlockId* blocks)
+    {
+        version++;
+        BlockId sectionBlocks[SECTION_VOLUME];
+        for (int sy = 0; sy < CHUNK_SECTIONS; sy++)
+            for (int sz = 0; sz < CHUNK_SECTIONS; sz++)
+                for (int sx = 0; sx < CHUNK_SECTIONS; sx++) {
+                    BlockId* out = sectionBlocks;
+                    for (int y = 0; y < SECTION_SIZE; y++)
+                        for (int z = 0; z < SECTION_SIZE; z++) {
+                            const BlockId* row = blocks + ((sy * SECTION_SIZE + y) * CHUNK_SIZE + sz * SECTION_SIZE + z) * CHUNK_SIZE + sx * SECTION_SIZE;
+                            out = std::copy(row, row + SECTION_SIZE, out);
+                        }
+                    sections[(sy * CHUNK_SECTIONS + sz) * CHUNK_SECTIONS + sx].Encode(sectionBlocks);
+                }
+    }
+
+    const ChunkSection& Section(int sx, int sy, int sz) const { return sections[(sy * CHUNK_SECTIONS + sz) * CHUNK_SECTIONS + sx]; }
+
+    bool IsEmpty() const
+    {
+        for (const ChunkSection& section : sections) {
+            if (section.NonAirCount() > 0)
+                return false;
+        }
+        return true;
+    }
+
+    size_t MemoryUsage() const
+    {
+        size_t bytes = sizeof(Chunk) - sizeof(sections);
+        for (const ChunkSection& section : sections)
+            bytes += section.MemoryUsage();
+        return bytes;
+    }
+
+private:
+    ChunkSection sections[CHUNK_SECTIONS * CHUNK_SECTIONS * CHUNK_SECTIONS];
+    unsigned int version = 0;
+
+    static int sectionIndex(int x, int y, int z)
+    {
+        return ((y / SECTION_SIZE) * CHUNK_SECTIONS + z / SECTION_SIZE) * CHUNK_SECTIONS + x / SECTION_SIZE;
+    }
+};
+
+
+// Rolling test terrain (stone, dirt, grass, scattered ore) around a height of 40 blocks. Cheap and predictable, for the storage
+// and meshing benchmarks; the world itself comes from TerrainGenerator
+inline void FillTestTerrain(Chunk& chunk, BenchmarkRandom& random)
+{
+    glm::ivec3 origin = chunk.Position * CHUNK_SIZE;
+    for (int z = 0; z < CHUNK_SIZE; z++)
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            float wx = (float)(origin.x + x), wz = (float)(origin.z + z);
+            int height = 40 + (int)(12.0f * std::sin(wx * 0.05f) * std::cos(wz * 0.04f));
+            int top = height - origin.y;
+            if (top < 0)
+                continue;
+            chunk.FillBox(glm::ivec3(x, 0, z), glm::ivec3(x, top - 4, z), BLOCK_STONE);
+            chunk.FillBox(glm::ivec3(x, top - 3, z), glm::ivec3(x, top - 1, z), BLOCK_DIRT);
+            chunk.FillBox(glm::ivec3(x, top, z), glm::ivec3(x, top, z), BLOCK_GRASS);
+        }
+    for (int i = 0; i < 64; i++) {
+        int x = random.Next() % CHUNK_SIZE, y = random.Next() % CHUNK_SIZE, z = random.Next() % CHUNK_SIZE;
+        if (chunk.Get(x, y, z) == BLOCK_STONE)
+            chunk.Set(x, y, z, BLOCK_ORE);
+    }
+}
+
+
+// Fills a grid of chunks with the test terrain and reports the memory it takes next to a plain 16-bit array, then times
+// random Get/Set
+inline void BenchmarkVoxelStorage(int chunksX, int chunksY, int chunksZ)
+{
+    BenchmarkRandom random(1234u);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<Chunk> chunks;
+    chunks.reserve((size_t)chunksX * chunksY * chunksZ);
+    for (int cy = 0; cy < chunksY; cy++)
+        for (int cz = 0; cz < chunksZ; cz++)
+            for (int cx = 0; cx < chunksX; cx++) {
+                chunks.emplace_back(glm::ivec3(cx, cy, cz));
+                FillTestTerrain(chunks.back(), random);
+            }
+    auto generateEnd = std::chrono::high_resolution_clock::now();
+
+    size_t bytes = 0;
+    int uniformSections = 0;
+    for (const Chunk& chunk : chunks) {
+        bytes += chunk.MemoryUsage();
+        for (int sy = 0; sy < CHUNK_SECTIONS; sy++)
+            for (int sz = 0; sz < CHUNK_SECTIONS; sz++)
+                for (int sx = 0; sx < CHUNK_SECTIONS; sx++)
+                    uniformSections += chunk.Section(sx, sy, sz).IsUniform();
+    }
+    size_t blocks = chunks.size() * CHUNK_VOLUME;
+
+    const int operations = 10000000;
+    unsigned int checksum = 0;
+    auto getStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < operations; i++) {
+        unsigned int r = random.Next();
+        checksum += chunks[r % chunks.size()].Get(r & 31, (r >> 5) & 31, (r >> 10) & 31);
+    }
+    auto setStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < operations; i++) {
+        unsigned int r = random.Next();
+        chunks[r % chunks.size()].Set(r & 31, (r >> 5) & 31, (r >> 10) & 31, (BlockId)(r >> 20) % BLOCK_TYPE_COUNT);
+    }
+    auto setEnd = std::chrono::high_resolution_clock::now();
+
+    std::cout << "BENCHMARK::VOXEL_STORAGE " << chunks.size() << " chunks, " << blocks << " blocks, generated in " << BenchmarkMs(start, generateEnd) << " ms" << std::endl;
+    std::cout << "  memory: " << bytes / (1024.0 * 1024.0) << " MB (" << bytes / chunks.size() << " bytes per chunk), flat 16-bit array "
+        << blocks * sizeof(BlockId) / (1024.0 * 1024.0) << " MB, " << uniformSections << " uniform sections" << std::endl;
+    std::cout << "  random get: " << BenchmarkMs(getStart, setStart) * 1e6 / operations << " ns, random set: " << BenchmarkMs(setStart, setEnd) * 1e6 / operations
+        << " ns (checksum " << checksum << ")" << std::endl;
+}
+
+#endif
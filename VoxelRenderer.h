@@ -0,0 +1,351 @@
+#ifndef VOXEL_RENDERER_H
+#define VOXEL_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Camera.h"
+#include "ChunkMesher.h"
+#include "GpuBufferArena.h"
+#include "MeshingPipeline.h"
+#include "Shader.h"
+#include "VoxelChunk.h"
+
+// Default voxel rendering values
+const glm::vec3 VOXEL_WORLD_ORIGIN = glm::vec3(-128.0f, -60.0f, -128.0f);     // world position of chunk (0, 0, 0)'s minimum corner
+const unsigned int VOXEL_INITIAL_QUAD_INDICES = 4096;                           // quads the shared index buffer covers at first, grows as needed
+const int VOXEL_FACE_TEXTURE_UNIT = 3;                                          // where pulled face records are bound, 0-2 are taken by the cubes
+const int VOXEL_SHADER_BLOCK_COLORS = 16;                                        // size of voxel.fs's blockColors, block ids past it are clamped
+
+// tint of every block type (Block_Type), voxel.fs multiplies the texture with it
+const glm::vec3 VOXEL_BLOCK_COLORS[BLOCK_TYPE_COUNT] = {
+    glm::vec3(1.0f),                // air, never drawn
+    glm::vec3(0.55f, 0.55f, 0.58f), // stone
+    glm::vec3(0.55f, 0.38f, 0.24f), // dirt
+    glm::vec3(0.35f, 0.70f, 0.25f), // grass
+    glm::vec3(0.90f, 0.85f, 0.60f), // sand
+    glm::vec3(0.50f, 0.35f, 0.20f), // wood
+    glm::vec3(0.20f, 0.55f, 0.20f), // leaves
+    glm::vec3(0.95f, 0.75f, 0.30f)  // ore
+};
+static_assert(BLOCK_TYPE_COUNT <= VOXEL_SHADER_BLOCK_COLORS, "voxel.fs's blockColors must hold every block type");
+
+
+// Draws chunk meshes in one of two layouts (Voxel_Mesh_Format). Every chunk's mesh is a range of one of a few big buffers
+// (GpuBufferArena), so an upload is a single glBufferSubData of what MeshingPipeline made and there is one VAO or buffer
+// texture per arena, not per chunk:
+//  - packed vertices (PackVoxelVertex, unpacked by voxel.vs): drawn indexed from one shared index buffer holding the
+//    VOXEL_QUAD_INDICES pattern for as many quads as the biggest chunk has, with the chunk's first vertex as base vertex,
+//  - pulled faces (PackVoxelFace, voxelPull.vs): the vertex shader reads the arena as a buffer texture and builds the 6
+//    vertices of a quad from gl_VertexID, so a chunk is one non-indexed draw with no vertex attributes at all.
+class VoxelRenderer
+{
+public:
+    glm::vec3 WorldOrigin;
+    // skip every chunk's quads that face away from the camera (see Draw)
+    bool CullFaceRanges = true;
+
+    // statistics of the last Draw
+    unsigned int ChunksDrawn = 0;
+    unsigned int ChunksCulled = 0;
+    unsigned int QuadsDrawn = 0;
+    unsigned int QuadsFacingAway = 0;   // in the chunks drawn, skipped with CullFaceRanges
+
+    // cumulative statistics
+    unsigned int UploadsFailed = 0;     // meshes the arena had no room for, the chunk keeps its previous mesh
+
+    VoxelRenderer(Voxel_Mesh_Format format = VOXEL_PACKED_VERTICES, const glm::vec3& worldOrigin = VOXEL_WORLD_ORIGIN)
+        : WorldOrigin(worldOrigin), format(format), arena(arenaBytes())
+    {
+        glGenBuffers(1, &indexBuffer);
+        growIndices(VOXEL_INITIAL_QUAD_INDICES);
+        // core profile draws need a VAO even when nothing is read from it
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    ~VoxelRenderer()
+    {
+        deleteViews();
+        glDeleteBuffers(1, &indexBuffer);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    VoxelRenderer(const VoxelRenderer&) = delete;
+    VoxelRenderer& operator=(const VoxelRenderer&) = delete;
+
+    // sets the block colors and the texture unit on a shader built from voxel.fs
+    static void SetupShader(Shader& shader, int textureUnit)
+    {
+        shader.use();
+        shader.setInt("texture1", textureUnit);
+        // the entries past the known block types are set too, ids without a color are drawn untinted instead of black
+        for (int i = 0; i < VOXEL_SHADER_BLOCK_COLORS; i++)
+            shader.setVec3("blockColors[" + std::to_string(i) + "]", i < BLOCK_TYPE_COUNT ? VOXEL_BLOCK_COLORS[i] : glm::vec3(1.0f));
+    }
+
+    Voxel_Mesh_Format Format() const { return format; }
+
+    // drops every chunk, the meshes have to be uploaded again in the new format
+    void SetFormat(Voxel_Mesh_Format newFormat)
+    {
+        if (newFormat == format)
+            return;
+        Clear();
+        // the arenas are reused, only how they are read changes
+        deleteViews();
+        format = newFormat;
+    }
+
+    void Clear()
+    {
+        for (auto& entry : chunks)
+            arena.Free(entry.second.allocation);
+        chunks.clear();
+        vertexBytes = 0;
+    }
+
+    const GpuBufferArena& Buffers() const { return arena; }
+
+    // compacts the mesh buffers a little, once per frame
+    size_t Defragment(size_t maxBytes = GPU_ARENA_DEFRAG_BYTES) { return arena.Defragment(maxBytes); }
+
+    unsigned int ChunkCount() const { return (unsigned int)chunks.size(); }
+
+    // bytes of vertex data or face records on the GPU, the shared index buffer not included
+    size_t VertexBytes() const { return vertexBytes; }
+
+    // replaces a chunk's mesh, GL thread (MeshingPipeline::Poll's callback). Meshes packed in another format than the
+    // renderer's, left over from before a SetFormat, are ignored
+    void Upload(const MeshedChunk& meshed)
+    {
+        if (meshed.Format != format)
+            return;
+        if (meshed.Mesh.Quads.empty()) {
+            Remove(meshed.Position);
+            return;
+        }
+
+        // a new range every time, the old one may be the wrong size and is free for the next mesh
+        size_t bytes = meshed.Vertices.size() * sizeof(uint32_t);
+        int allocation = arena.Allocate((uint32_t)bytes);
+        if (allocation < 0) {
+            UploadsFailed++;
+            std::cout << "ERROR::VOXEL_RENDERER::UPLOAD_FAILED chunk (" << meshed.Position.x << ", " << meshed.Position.y << ", "
+                << meshed.Position.z << "), " << bytes << " bytes" << std::endl;
+            return;
+        }
+        Remove(meshed.Position);
+        ChunkBuffers& buffers = chunks[meshed.Position];
+        buffers.allocation = allocation;
+        buffers.bytes = bytes;
+        vertexBytes += bytes;
+        std::copy(meshed.Mesh.FaceStart, meshed.Mesh.FaceStart + 7, buffers.faceStart);
+        arena.Upload(allocation, meshed.Vertices.data(), bytes);
+
+        unsigned int quads = (unsigned int)meshed.Mesh.Quads.size();
+        if (format == VOXEL_PACKED_VERTICES && quads > indexQuads)
+            growIndices(quads);
+    }
+
+    void Remove(const glm::ivec3& position)
+    {
+        auto it = chunks.find(position);
+        if (it == chunks.end())
+            return;
+        vertexBytes -= it->second.bytes;
+        arena.Free(it->second.allocation);
+        chunks.erase(it);
+    }
+
+    // draws every chunk inside the camera's frustum with the shader in use, which must be built on voxel.vs or, for
+    // pulled faces, voxelPull.vs.
+    // The quads of a chunk are grouped by face (ChunkMesh::FaceStart). A +x face in slice x lies in the plane origin.x + x + 1
+    // and can only be seen from beyond it, so once the camera isn't past the lowest of those planes no +x face of the chunk
+    // can be seen, likewise for the other five. From outside a chunk that leaves at most three of the six ranges, and the
+    // ones left that follow each other in the buffer are drawn as one range. Hardware back-face culling would drop the
+    // same triangles, but only after their vertices were fetched and transformed
+    void Draw(Shader& shader, const Camera& camera)
+    {
+        ChunksDrawn = 0;
+        ChunksCulled = 0;
+        QuadsDrawn = 0;
+        QuadsFacingAway = 0;
+        createViews();
+        bool pulled = format == VOXEL_PULLED_FACES;
+        if (pulled) {
+            glBindVertexArray(emptyVAO);
+            glActiveTexture(GL_TEXTURE0 + VOXEL_FACE_TEXTURE_UNIT);
+        }
+        int boundArena = -1;
+        for (auto& entry : chunks) {
+            glm::vec3 origin = ChunkOrigin(entry.first);
+            if (!camera.IsBoxInFrustum(origin, origin + glm::vec3((float)CHUNK_SIZE))) {
+                ChunksCulled++;
+                continue;
+            }
+            const ChunkBuffers& buffers = entry.second;
+
+            // visible face ranges in quads, neighbors merged
+            unsigned int rangeStart[6], rangeQuads[6];
+            int ranges = 0;
+            for (int face = 0; face < 6; face++) {
+                unsigned int quads = buffers.faceStart[face + 1] - buffers.faceStart[face];
+                if (quads == 0)
+                    continue;
+                if (CullFaceRanges && !faceRangeVisible(face, origin, camera.Position)) {
+                    QuadsFacingAway += quads;
+                    continue;
+                }
+                if (ranges > 0 && rangeStart[ranges - 1] + rangeQuads[ranges - 1] == buffers.faceStart[face]) {
+                    rangeQuads[ranges - 1] += quads;
+                }
+                else {
+                    rangeStart[ranges] = buffers.faceStart[face];
+                    rangeQuads[ranges] = quads;
+                    ranges++;
+                }
+                QuadsDrawn += quads;
+            }
+            if (ranges == 0)
+                continue;
+
+            // one call per chunk either way, every range is 6 vertices (or indices) per quad
+            GLsizei counts[6];
+            for (int i = 0; i < ranges; i++)
+                counts[i] = (GLsizei)rangeQuads[i] * 6;
+            shader.setVec3("chunkOrigin", origin);
+            int chunkArena = arena.ArenaOf(buffers.allocation);
+            uint32_t offset = arena.OffsetOf(buffers.allocation);
+            if (pulled) {
+                // gl_VertexID counts from first, so the record index the shader derives from it includes the chunk's offset
+                GLint firsts[6];
+                for (int i = 0; i < ranges; i++)
+                    firsts[i] = (GLint)(offset / (2 * sizeof(uint32_t)) + rangeStart[i]) * 6;
+                if (chunkArena != boundArena)
+                    glBindTexture(GL_TEXTURE_BUFFER, views[chunkArena].faceTexture);
+                glMultiDrawArrays(GL_TRIANGLES, firsts, counts, ranges);
+            }
+            else {
+                // quad q's indices start at q * 6 and point at its vertices q * 4 onwards, counted from the base vertex
+                const void* offsets[6];
+                GLint baseVertices[6];
+                for (int i = 0; i < ranges; i++) {
+                    offsets[i] = (const void*)((size_t)rangeStart[i] * 6 * sizeof(uint32_t));
+                    baseVertices[i] = (GLint)(offset / sizeof(uint32_t));
+                }
+                if (chunkArena != boundArena)
+                    glBindVertexArray(views[chunkArena].vao);
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, ranges, baseVertices);
+            }
+            boundArena = chunkArena;
+            ChunksDrawn++;
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    glm::vec3 ChunkOrigin(const glm::ivec3& position) const { return WorldOrigin + glm::vec3(position * CHUNK_SIZE); }
+
+private:
+    struct ChunkBuffers {
+        int allocation = -1;            // GpuBufferArena handle of the vertices or face records
+        unsigned int faceStart[7] = {}; // ChunkMesh::FaceStart, faceStart[6] is the quad count
+        size_t bytes = 0;
+    };
+
+    // how the draws read an arena
+    struct ArenaView {
+        unsigned int vao = 0;           // packed vertices
+        unsigned int faceTexture = 0;   // pulled faces, the arena as a buffer texture
+    };
+
+    Voxel_Mesh_Format format;
+    GpuBufferArena arena;
+    std::vector<ArenaView> views;       // by arena, for the current format
+    std::unordered_map<glm::ivec3, ChunkBuffers, ChunkPositionHash> chunks;
+    unsigned int emptyVAO = 0;
+    unsigned int indexBuffer = 0;
+    unsigned int indexQuads = 0;    // quads the index buffer covers
+    size_t vertexBytes = 0;
+
+    // whether any face along Voxel_Face face of the chunk at origin can be seen from eye (see Draw)
+    static bool faceRangeVisible(int face, const glm::vec3& origin, const glm::vec3& eye)
+    {
+        int d = face / 2;
+        if (face % 2 == 0)
+            return eye[d] > origin[d] + 1.0f;
+        return eye[d] < origin[d] + (float)(CHUNK_SIZE - 1);
+    }
+
+    // GPU_ARENA_BYTES, or less if a buffer texture can't address that many face records (GL 3.3 only promises 65536 texels)
+    static uint32_t arenaBytes()
+    {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        return (uint32_t)std::min<size_t>(GPU_ARENA_BYTES, (size_t)maxTexels * 2 * sizeof(uint32_t));
+    }
+
+    // views of the arenas created since the last call
+    void createViews()
+    {
+        while ((int)views.size() < arena.ArenaCount()) {
+            unsigned int buffer = arena.Buffer((int)views.size());
+            ArenaView view;
+            if (format == VOXEL_PULLED_FACES) {
+                // two uint32 per face, fetched as one RG32UI texel
+                glGenTextures(1, &view.faceTexture);
+                glActiveTexture(GL_TEXTURE0 + VOXEL_FACE_TEXTURE_UNIT);
+                glBindTexture(GL_TEXTURE_BUFFER, view.faceTexture);
+                glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, buffer);
+                glBindTexture(GL_TEXTURE_BUFFER, 0);
+                glActiveTexture(GL_TEXTURE0);
+            }
+            else {
+                glGenVertexArrays(1, &view.vao);
+                glBindVertexArray(view.vao);
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+                glEnableVertexAttribArray(0);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+                glBindVertexArray(0);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+            views.push_back(view);
+        }
+    }
+
+    void deleteViews()
+    {
+        for (ArenaView& view : views) {
+            if (view.vao)
+                glDeleteVertexArrays(1, &view.vao);
+            if (view.faceTexture)
+                glDeleteTextures(1, &view.faceTexture);
+        }
+        views.clear();
+    }
+
+    // refills the index buffer for at least quads quads. The buffer object stays the same, so the VAOs pointing at it don't change
+    void growIndices(unsigned int quads)
+    {
+        indexQuads = std::max(quads, indexQuads * 2);
+        std::vector<uint32_t> indices(indexQuads * 6);
+        for (unsigned int quad = 0; quad < indexQuads; quad++)
+            for (int i = 0; i < 6; i++)
+                indices[quad * 6 + i] = quad * 4 + VOXEL_QUAD_INDICES[i];
+
+        // the element buffer binding belongs to the bound VAO, so fill it through a target that doesn't
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+};
+
+#endif
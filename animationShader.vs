@@ -0,0 +1,27 @@
+#version 330 core
+
+// Per-instance animation state, one point per animated instance
+layout(location = 0) in vec4 aPositionPhase;   // xyz = world position, w = starting angle (radians)
+layout(location = 1) in vec4 aAxisSpeed;       // xyz = normalized spin axis, w = angular speed (radians / second)
+
+// The model matrix columns, captured with transform feedback straight into the instance buffer
+out vec4 modelColumn0;
+out vec4 modelColumn1;
+out vec4 modelColumn2;
+out vec4 modelColumn3;
+
+uniform float time;
+
+void main() {
+    float angle = aPositionPhase.w + aAxisSpeed.w * time;
+    float c = cos(angle);
+    float s = sin(angle);
+    vec3 axis = aAxisSpeed.xyz;
+    vec3 temp = (1.0 - c) * axis;
+
+    // same rotation glm::rotate builds, followed by the translation
+    modelColumn0 = vec4(c + temp.x * axis.x, temp.x * axis.y + s * axis.z, temp.x * axis.z - s * axis.y, 0.0);
+    modelColumn1 = vec4(temp.y * axis.x - s * axis.z, c + temp.y * axis.y, temp.y * axis.z + s * axis.x, 0.0);
+    modelColumn2 = vec4(temp.z * axis.x + s * axis.y, temp.z * axis.y - s * axis.x, c + temp.z * axis.z, 0.0);
+    modelColumn3 = vec4(aPositionPhase.xyz, 1.0);
+}
\ No newline at end of file
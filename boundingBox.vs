@@ -0,0 +1,16 @@
+#version 330 core
+
+// unit cube corner in [-1, 1], stretched over the box being tested
+layout(location = 0) in vec3 aPos;
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+layout(std140) uniform Matrices {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    gl_Position = projection * view * vec4(mix(boxMin, boxMax, aPos * 0.5 + 0.5), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth prepass: vertexShader.vs writes the depth, nothing is shaded
+
+void main() {
+}
\ No newline at end of file
@@ -21,10 +21,19 @@ Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 bool firstMouse = true;
 float lastX = screenWidth / 2.0;
 float lastY = screenHeight / 2.0;
+InputLatch mouseLatch;	// mouse look is applied late in the frame, see the render loop
 
-//Frame Data
-float deltaTime = 0.0f;	// Time between current frame and last frame
-float lastFrame = 0.0f; // Time of last frame
+//Simulation (camera movement, texture mixing and animation time run on their own fixed-rate thread)
+SimulationInput simulationInput;	// filled from the keyboard every frame by processInput
+
+//Render Modes (toggled with P, O, V, C, M, F and N)
+bool depthPrepass = false;		// depth-only pass first, then shade with GL_EQUAL so every pixel is shaded once
+bool sortFrontToBack = true;	// draw the cubes nearest first so the depth test rejects what's behind them
+bool showOverdraw = false;		// shade every fragment with a constant, additively blended, to see how often pixels are shaded
+bool occlusionCulling = true;	// skip cubes hidden behind others with occlusion queries and conditional rendering
+bool cpuOcclusionCulling = true;	// test cubes against a software rasterized occluder depth buffer before submitting them
+bool vertexPulling = false;		// draw the terrain from one record per face expanded in the vertex shader instead of packed vertices
+bool faceRangeCulling = true;	// skip the terrain quads facing away from the camera, per chunk and face direction
 
 
 // ------------------------------------------------------------- //
@@ -32,38 +41,61 @@ float lastFrame = 0.0f; // Time of last frame
 // ------------------------------------------------------------- //
 
 
-void processInput(GLFWwindow* window) {
-	const float cameraSpeed = 7.5f * deltaTime; // adjust accordingly
+// true only on the frame the key goes down
+bool keyPressed(GLFWwindow* window, int key) {
+	static bool wasDown[GLFW_KEY_LAST + 1] = {};
+	bool down = glfwGetKey(window, key) == GLFW_PRESS;
+	bool pressed = down && !wasDown[key];
+	wasDown[key] = down;
+	return pressed;
+}
 
+void processInput(GLFWwindow* window) {
 	// Exit the program if ESC is pressed
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)	{
 		glfwSetWindowShouldClose(window, true);
 	}
 
-	//Texture Mixing
-	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)	{
-		mixValue += 0.005f; // change this value accordingly (might be too slow or too fast based on system hardware)
-		if (mixValue >= 1.0f)
-			mixValue = 1.0f;
-	}
-	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)	{
-		mixValue -= 0.005f; // change this value accordingly (might be too slow or too fast based on system hardware)
-		if (mixValue <= 0.0f)
-			mixValue = 0.0f;
-	}
+	//Texture Mixing (applied by the simulation at a fixed rate, so the speed no longer depends on the frame rate)
+	simulationInput.mixUp = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
+	simulationInput.mixDown = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
 
 	//Camera Movement
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)	{
-		camera.ProcessKeyboard(FORWARD, deltaTime);
+	simulationInput.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+	simulationInput.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+	simulationInput.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+	simulationInput.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+	simulationInput.front = camera.Front;
+	simulationInput.rightVector = camera.Right;
+
+	//Render Modes
+	if (keyPressed(window, GLFW_KEY_P))	{
+		depthPrepass = !depthPrepass;
+		std::cout << "depth prepass " << (depthPrepass ? "on" : "off") << std::endl;
 	}
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)	{
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (keyPressed(window, GLFW_KEY_O))	{
+		sortFrontToBack = !sortFrontToBack;
+		std::cout << "front to back sorting " << (sortFrontToBack ? "on" : "off") << std::endl;
 	}
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)	{
-		camera.ProcessKeyboard(LEFT, deltaTime);
+	if (keyPressed(window, GLFW_KEY_V))	{
+		showOverdraw = !showOverdraw;
+		std::cout << "overdraw view " << (showOverdraw ? "on" : "off") << std::endl;
 	}
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)	{
-		camera.ProcessKeyboard(RIGHT, deltaTime);
+	if (keyPressed(window, GLFW_KEY_C))	{
+		occlusionCulling = !occlusionCulling;
+		std::cout << "occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+	}
+	if (keyPressed(window, GLFW_KEY_M))	{
+		cpuOcclusionCulling = !cpuOcclusionCulling;
+		std::cout << "CPU occlusion culling " << (cpuOcclusionCulling ? "on" : "off") << std::endl;
+	}
+	if (keyPressed(window, GLFW_KEY_F))	{
+		vertexPulling = !vertexPulling;
+		std::cout << "terrain vertex pulling " << (vertexPulling ? "on" : "off") << std::endl;
+	}
+	if (keyPressed(window, GLFW_KEY_N))	{
+		faceRangeCulling = !faceRangeCulling;
+		std::cout << "terrain face range culling " << (faceRangeCulling ? "on" : "off") << std::endl;
 	}
 }
 
@@ -84,7 +116,7 @@ void mouse_callback(GLFWwindow* window, double xPosIn, double yPosIn) {
 	lastX = xpos;
 	lastY = ypos;
 
-	camera.ProcessMouseMovement(xOffset, yOffset);
+	mouseLatch.AddMouseDelta(xOffset, yOffset, glfwGetTime());
 
 }
 
@@ -102,6 +134,10 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 	screenWidth = width;
 	screenHeight = height;
 	glViewport(0, 0, width, height);
+
+	// a minimized window reports 0x0, keep the last aspect ratio instead of dividing by zero
+	if (height > 0)
+		camera.SetAspectRatio((float)width / (float)height);
 }
 
 
@@ -111,8 +147,29 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 
 
 int main() {
+	// worker threads for CPU side work that doesn't touch GL
+	JobSystem jobSystem;
+
+#ifdef RUN_BENCHMARKS
+	BenchmarkTransforms(100000, 100);
+	BenchmarkOcclusionCulling(jobSystem, 200000, 20);
+	BenchmarkSpatialIndex(jobSystem, 1000000);
+	BenchmarkVoxelStorage(32, 4, 32);
+	BenchmarkChunkMeshing(16, 3, 16);
+	BenchmarkMeshingPipeline(jobSystem, 16, 3, 16);
+	BenchmarkRangeAllocator(1000000);
+	BenchmarkTerrainGeneration(jobSystem, 16, 2, 16);
+	return 0;
+#endif
+
 	// Initialize GLFW and set OpenGL version
 	glfwInit();
+
+	// terminates GLFW, and with it the context, when main returns. Declared before everything that owns GL objects, so
+	// those are destroyed first while the context is still current
+	struct GlfwSession {
+		~GlfwSession() { glfwTerminate(); }
+	} glfwSession;
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -129,11 +186,19 @@ int main() {
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+
+	// adaptive vsync where the driver has it, plus a frame limiter so fast machines don't render frames nobody sees (it stands
+	// aside while vsync already caps the rate)
+	FramePacer framePacer(FRAME_TARGET_FPS);
+	framePacer.SetVSync(VSYNC_ADAPTIVE);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);	//Keeps Mouse Focused On Windows
+	if (glfwRawMouseMotionSupported())	{
+		glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);	//Unaccelerated, unscaled motion for camera look
+	}
 
 	// Load OpenGL function pointers using GLAD	
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -147,9 +212,22 @@ int main() {
 
 	shaderProgram = ourShader.ID;
 
+	// same vertex shader, so the prepass depths match the main pass exactly
+	Shader depthShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/vertexShader.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/depthOnly.fs");
+	Shader overdrawShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/vertexShader.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/overdraw.fs");
+	Shader boxShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/boundingBox.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/depthOnly.fs");
+	// voxel terrain: packed chunk vertices, again one vertex shader for every pass
+	Shader voxelShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxel.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxel.fs");
+	Shader voxelDepthShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxel.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/depthOnly.fs");
+	Shader voxelOverdrawShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxel.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/overdraw.fs");
+	Shader voxelPullShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxelPull.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxel.fs");
+	Shader voxelPullDepthShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxelPull.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/depthOnly.fs");
+	Shader voxelPullOverdrawShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/voxelPull.vs", "C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/overdraw.fs");
+
 	// Set initial viewport and resize callback
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glViewport(0, 0, screenWidth, screenHeight);
+	camera.SetAspectRatio((float)screenWidth / (float)screenHeight);
 	
 
 	// ------------------------------------------------------------- //
@@ -222,6 +300,16 @@ int main() {
 		glm::vec3(-2.6f,   2.0f,  -3.0f)
 	};
 
+	// cube transforms live in the SoA transform system; every third cube spins (animated on the GPU), the rest keep a fixed tilt
+	TransformSystem cubeTransforms;
+	for (unsigned int x = 0; x < 10; x++)	{
+		cubeTransforms.Add(cubePositions[x]);
+		if (x % 3 != 0)	{
+			float angle = 20.0f * x;
+			cubeTransforms.SetRotation(x, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+		}
+	}
+
 
 
 	// ------------------------------------------------------------- //
@@ -248,148 +336,504 @@ int main() {
 
 
 	// ------------------------------------------------------------- //
-	//                          TEXTURING	                         //
+	//                          INSTANCE DATA                        //
 	// ------------------------------------------------------------- //
 
 
-	unsigned int texture1;
-	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// load and generate the texture
-	int width, height, nrChannels;
-
-	unsigned char* data = stbi_load("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/container.jpg", &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	// Every cube's model matrix lives in one instance buffer that the vertex shader reads through a buffer texture.
+	// The spinning cubes take the first slots so the transform feedback pass can write them as one contiguous range,
+	// the static cubes follow and are composed once on the CPU.
+	std::vector<unsigned int> animatedCubes;
+	std::vector<unsigned int> staticCubes;
+	for (unsigned int x = 0; x < 10; x++)	{
+		if (x % 3 == 0)
+			animatedCubes.push_back(x);
+		else
+			staticCubes.push_back(x);
 	}
-	else {
-		std::cout << "Failed to load texture" << std::endl;
+	unsigned int animatedCount = (unsigned int)animatedCubes.size();
+	unsigned int instanceCount = animatedCount + (unsigned int)staticCubes.size();
+
+	// where the cube in each instance slot is, for sorting draws by distance
+	std::vector<glm::vec3> slotPositions;
+	for (unsigned int x : animatedCubes)
+		slotPositions.push_back(cubePositions[x]);
+	for (unsigned int x : staticCubes)
+		slotPositions.push_back(cubePositions[x]);
+	std::vector<unsigned int> drawOrder(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+		drawOrder[i] = i;
+
+	std::vector<glm::mat4> cubeModels(cubeTransforms.Count());
+	cubeTransforms.Compose(cubeModels.data());
+
+	unsigned int instanceBuffer, instanceTexture;
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, instanceCount * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+	for (unsigned int i = 0; i < staticCubes.size(); i++)	{
+		glBufferSubData(GL_TEXTURE_BUFFER, (animatedCount + i) * sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(cubeModels[staticCubes[i]]));
 	}
-	stbi_image_free(data);
 
+	glGenTextures(1, &instanceTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
 
-	unsigned int texture2;
-	glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
+	// Animation state of the spinning cubes: position + starting angle, then spin axis + angular speed. The transform feedback
+	// pass turns it into model matrices on the GPU every frame, so the CPU never touches these instances again
+	std::vector<glm::vec4> animationState;
+	for (unsigned int x : animatedCubes)	{
+		animationState.push_back(glm::vec4(cubePositions[x], 0.0f));
+		animationState.push_back(glm::vec4(glm::normalize(glm::vec3(0.5f, 1.0f, 0.0f)), 1.0f));
+	}
 
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	unsigned int animationVAO, animationVBO;
+	glGenVertexArrays(1, &animationVAO);
+	glGenBuffers(1, &animationVBO);
 
-	// load and generate the texture
-	data = stbi_load("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/awesomeface.png", &width, &height, &nrChannels, 0);
-	if (data) {
-		GLenum format = nrChannels == 4 ? GL_RGBA : GL_RGB;
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	glBindVertexArray(animationVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, animationVBO);
+	glBufferData(GL_ARRAY_BUFFER, animationState.size() * sizeof(glm::vec4), animationState.data(), GL_STATIC_DRAW);
 
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else {
-		std::cout << "Failed to load texture" << std::endl;
-	}
-	stbi_image_free(data);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)sizeof(glm::vec4));
+	glEnableVertexAttribArray(1);
 
+	const char* animationVaryings[] = { "modelColumn0", "modelColumn1", "modelColumn2", "modelColumn3" };
+	Shader animationShader("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/animationShader.vs", animationVaryings, 4);
 
-	ourShader.use(); // don't forget to activate/use the shader before setting uniforms!
-	ourShader.setInt("texture1", 0);	// either set it manually like so:
-	ourShader.setInt("texture2", 1);	// or set it via the texture class
+	glBindVertexArray(0);
 
 
 	// ------------------------------------------------------------- //
-	//                          RENDER LOOP                          //
+	//                          TEXTURING	                         //
 	// ------------------------------------------------------------- //
 
 
-	while (!glfwWindowShouldClose(window)) {
+	// load the textures (decoded pixels come from the texture cache after the first run) and hand them to the streamer,
+	// which uploads the small mips now and streams the larger ones in once cubes get close enough to need them
+	TextureCache textureCache("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/texture_cache");
+	TextureLoadOptions textureOptions;
+	textureOptions.buildMipChain = true;
 
-		float currentFrame = static_cast<float>(glfwGetTime());
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
+	TextureStreamer textureStreamer;
 
+	// a texture that fails to load keeps the handle -1, which the streamer ignores and binds as texture 0
+	int containerTexture = -1;
+	std::unique_ptr<CachedImage> image(new CachedImage());
+	if (textureCache.Load("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/container.jpg", textureOptions, *image)) {
+		containerTexture = textureStreamer.Add(std::move(image));
+	}
+	else {
+		std::cout << "Failed to load texture" << std::endl;
+	}
 
-		processInput(window);
+	int faceTexture = -1;
+	image.reset(new CachedImage());
+	if (textureCache.Load("C:/Users/iflyf/OneDrive/Documents/GitHub/learnOpenGL/awesomeface.png", textureOptions, *image)) {
+		faceTexture = textureStreamer.Add(std::move(image));
+	}
+	else {
+		std::cout << "Failed to load texture" << std::endl;
+	}
 
-		// Clear screen
-		glClearColor(0.0f, 0.5f, 0.8f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // also clear the depth buffer now!
+	unsigned int texture1 = textureStreamer.TextureID(containerTexture);
+	unsigned int texture2 = textureStreamer.TextureID(faceTexture);
 
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture2);
 
-		
+	ourShader.use(); // don't forget to activate/use the shader before setting uniforms!
+	ourShader.setInt("texture1", 0);	// either set it manually like so:
+	ourShader.setInt("texture2", 1);	// or set it via the texture class
+	ourShader.setInt("instanceMatrices", 2);
+	ourShader.setInt("baseInstance", 0);
+	ourShader.setBlockBinding("Matrices", 0);
+
+	glm::mat4 trans = glm::mat4(1.0f);
+	trans = glm::rotate(trans, glm::radians(-55.0f), glm::vec3(1.0, 0.0, 0.0));
+	for (Shader* shader : { &depthShader, &overdrawShader })	{
+		shader->use();
+		shader->setInt("instanceMatrices", 2);
+		shader->setInt("baseInstance", 0);
+		shader->setBlockBinding("Matrices", 0);
+		shader->setMat4("transform", trans);
+	}
+	boxShader.use();
+	boxShader.setBlockBinding("Matrices", 0);
+	VoxelRenderer::SetupShader(voxelShader, 0);
+	VoxelRenderer::SetupShader(voxelPullShader, 0);
+	for (Shader* shader : { &voxelShader, &voxelDepthShader, &voxelOverdrawShader, &voxelPullShader, &voxelPullDepthShader, &voxelPullOverdrawShader })	{
+		shader->use();
+		shader->setInt("faces", VOXEL_FACE_TEXTURE_UNIT);
+		shader->setBlockBinding("Matrices", 0);
+	}
 
-		// Draw the square
-		ourShader.use();
+	// occlusion culling bounds: the cube spans [-1, 1], so a half extent of sqrt(3) covers it in any rotation
+	OcclusionCuller occlusionCuller(boxShader);
+	std::vector<glm::vec3> slotBoundsMin, slotBoundsMax;
+	for (unsigned int i = 0; i < instanceCount; i++)	{
+		slotBoundsMin.push_back(slotPositions[i] - glm::vec3(1.7321f));
+		slotBoundsMax.push_back(slotPositions[i] + glm::vec3(1.7321f));
+		occlusionCuller.Add(slotBoundsMin[i], slotBoundsMax[i]);
+	}
 
-		glm::mat4 trans = glm::mat4(1.0f);
-		trans = glm::rotate(trans, glm::radians(-55.0f), glm::vec3(1.0, 0.0, 0.0));
+	// CPU occluders: the static cubes as they are drawn, the spinning ones by the box that stays inside them in any rotation
+	// (half extent 1 / sqrt(3))
+	MaskedOcclusion cpuOcclusion;
+	std::vector<glm::vec3> occluderTriangles;
+	for (unsigned int i = 0; i < staticCubes.size(); i++)	{
+		glm::mat4 world = cubeModels[staticCubes[i]] * trans;
+		for (unsigned int v = 0; v < 36; v++)
+			occluderTriangles.push_back(glm::vec3(world * glm::vec4(vertices[v * 5], vertices[v * 5 + 1], vertices[v * 5 + 2], 1.0f)));
+	}
+	for (unsigned int i = 0; i < animatedCount; i++)	{
+		MaskedOcclusion::AppendBoxTriangles(occluderTriangles, slotPositions[i] - glm::vec3(0.5773f), slotPositions[i] + glm::vec3(0.5773f));
+	}
+	std::vector<uint8_t> cubeVisible(instanceCount, 1);
+	std::vector<unsigned int> visibleOrder = drawOrder;	// drawOrder without the cubes outside the view or rejected by the CPU occlusion test
+
+	// BVH over the cube bounds, so view culling doesn't have to look at every cube
+	SpatialIndex cubeIndex;
+	cubeIndex.Build(slotBoundsMin.data(), slotBoundsMax.data(), instanceCount, &jobSystem);
+	std::vector<uint32_t> cubesInView;
+	std::vector<uint8_t> cubeInView(instanceCount, 0);
+
+	// terrain streamed in around the camera: generated within a per-frame budget, meshed on the workers, uploaded as the meshes come in
+	VoxelRenderer voxelRenderer(vertexPulling ? VOXEL_PULLED_FACES : VOXEL_PACKED_VERTICES);
+	ChunkManager chunkManager(jobSystem, voxelRenderer);
+
+	// camera matrices uniform buffer (std140: view, projection)
+	unsigned int matricesUBO;
+	glGenBuffers(1, &matricesUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
+	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, matricesUBO);
+
+#ifdef PRINT_FRAME_STATS
+	float lastStatsReport = 0.0f;
+#endif
 
-		ourShader.setFloat("mixValue", mixValue);
-		unsigned int transformLoc = glGetUniformLocation(ourShader.ID, "transform");
-		glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
 
+	// ------------------------------------------------------------- //
+	//                          RENDER LOOP                          //
+	// ------------------------------------------------------------- //
 
-		glm::mat4 model = glm::mat4(1.0f); // No transformations
-		glm::mat4 view = camera.GetViewMatrix(); // Up direction
-		glm::mat4 projection = glm::mat4(1.0f);
 
-		projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
+	RenderTargetPool renderTargetPool(screenWidth, screenHeight);
+	DynamicResolution dynamicResolution(renderTargetPool);
+	FrameGraph frameGraph(renderTargetPool);
+	GpuTimer shadedFragments(GL_SAMPLES_PASSED);	// fragments passing the depth test in the shading pass, i.e. how many got shaded
+
+	// every cube, either in one instanced call or one call per cube in visibleOrder (baseInstance picks the slot).
+	// With occlusionTest the occlusion culler decides per cube whether and how it is drawn
+	auto drawCubes = [&](Shader& shader, bool occlusionTest) {
+		if (occlusionTest)	{
+			occlusionCuller.Render(camera, visibleOrder,
+				[&]() {
+					shader.use();
+					glBindVertexArray(VAO);
+				},
+				[&](unsigned int slot) {
+					shader.setInt("baseInstance", slot);
+					glDrawArraysInstanced(GL_TRIANGLES, 0, 36, 1);
+				});
+			return;
+		}
 
-		// Get uniform locations
-		unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-		unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-		unsigned int projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+		glBindVertexArray(VAO);
+		if (!sortFrontToBack && !cpuOcclusionCulling && visibleOrder.size() == instanceCount)	{
+			shader.setInt("baseInstance", 0);
+			glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instanceCount);
+			return;
+		}
+		for (unsigned int slot : visibleOrder)	{
+			shader.setInt("baseInstance", slot);
+			glDrawArraysInstanced(GL_TRIANGLES, 0, 36, 1);
+		}
+	};
 
-		//Set Matrixes
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+	SimulationSnapshot initialState;
+	initialState.cameraPosition = camera.Position;
+	initialState.mixValue = mixValue;
+	Simulation simulation(initialState, SIMULATION_TICK_RATE, camera.MovementSpeed);
+	simulation.Start();
 
+	while (!glfwWindowShouldClose(window)) {
 
-		glBindVertexArray(VAO);
-		for (unsigned int x = 0; x < 10; x++)	{
+		// wait for this frame's slot before anything is sampled, so the limiter's idle time comes before input is read
+		// instead of between the late latch and the swap
+		framePacer.Wait();
+		glfwPollEvents();
 
-			// calculate the model matrix for each object and pass it to shader before drawing	
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[x]);
+		processInput(window);
+		simulation.SetInput(simulationInput);
 
-			if (x % 3 == 0)	{
-				model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(0.5f, 1.0f, 0.0f));
-			}
-			else	{
-				float angle = 20.0f * x;
-				model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			}
-			
+		// render state between the last two simulation ticks
+		SimulationSnapshot simState = simulation.Interpolate(simulation.Now());
+		camera.SetPosition(simState.cameraPosition);
+		mixValue = simState.mixValue;
 
-			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+		// offscreen targets follow the window size once it stops changing, the render scale follows the GPU time measured a few frames ago
+		renderTargetPool.RequestSize(screenWidth, screenHeight, glfwGetTime());
+		dynamicResolution.Update();
+		shadedFragments.Poll();
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		// every cube shows both textures across a 2 unit face, so each one asks for the mip its distance needs
+		for (unsigned int x = 0; x < 10; x++)	{
+			textureStreamer.Request(containerTexture, camera, cubePositions[x], 2.0f, screenHeight);
+			textureStreamer.Request(faceTexture, camera, cubePositions[x], 2.0f, screenHeight);
+		}
+		textureStreamer.Update();	// binds textures while uploading, so it runs before the units are set up
+
+		// switching the terrain format drops its meshes, they come back in the new format over the next frames
+		chunkManager.SetFormat(vertexPulling ? VOXEL_PULLED_FACES : VOXEL_PACKED_VERTICES);
+		voxelRenderer.CullFaceRanges = faceRangeCulling;
+		Shader& terrainShader = vertexPulling ? voxelPullShader : voxelShader;
+		Shader& terrainDepthShader = vertexPulling ? voxelPullDepthShader : voxelDepthShader;
+		Shader& terrainOverdrawShader = vertexPulling ? voxelPullOverdrawShader : voxelOverdrawShader;
+
+		// load and unload chunks around the camera, upload the meshes finished on the workers since the last frame
+		chunkManager.Update(camera, glfwGetTime());
+		voxelRenderer.Defragment();
+
+		// The frame is declared as a graph: passes say what they read and write, the graph culls what isn't needed, lends the
+		// scene targets from the pool only for as long as they live, clears them on first write and invalidates them after last use
+		frameGraph.Reset();
+
+		FrameTextureDesc sceneColorDesc;
+		sceneColorDesc.target.width = renderTargetPool.Width();
+		sceneColorDesc.target.height = renderTargetPool.Height();
+		sceneColorDesc.target.internalFormat = GL_RGBA8;
+		sceneColorDesc.clear = true;
+		sceneColorDesc.clearColor = showOverdraw ? glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) : glm::vec4(0.0f, 0.5f, 0.8f, 1.0f);
+		FrameTextureDesc sceneDepthDesc = sceneColorDesc;
+		sceneDepthDesc.target.internalFormat = GL_DEPTH24_STENCIL8;
+
+		FrameResource sceneColor = frameGraph.CreateTexture("scene color", sceneColorDesc);
+		FrameResource sceneDepth = frameGraph.CreateTexture("scene depth", sceneDepthDesc);
+		FrameResource backbuffer = frameGraph.ImportBackbuffer();
+
+		// animate the spinning cubes on the GPU: one point per instance, rasterizer off, matrices captured into the instance buffer
+		frameGraph.AddPass("animate",
+			[&](FramePassBuilder& pass) {
+				pass.SideEffect();	// writes the instance buffer, which the graph doesn't track
+			},
+			[&](const FramePassContext&) {
+				animationShader.use();
+				animationShader.setFloat("time", (float)simState.simulationTime);
+				glEnable(GL_RASTERIZER_DISCARD);
+				glBindVertexArray(animationVAO);
+				glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, instanceBuffer, 0, animatedCount * sizeof(glm::mat4));
+				glBeginTransformFeedback(GL_POINTS);
+				glDrawArrays(GL_POINTS, 0, animatedCount);
+				glEndTransformFeedback();
+				glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+				glDisable(GL_RASTERIZER_DISCARD);
+			});
+
+		// Late latch: everything else for the frame is set up, so pick up the newest mouse motion now and apply it
+		// right before the camera matrices are written, instead of a whole frame earlier in processInput
+		frameGraph.AddPass("camera",
+			[&](FramePassBuilder& pass) {
+				pass.SideEffect();	// writes the camera uniform buffer
+			},
+			[&](const FramePassContext&) {
+				glfwPollEvents();
+				mouseLatch.Latch(camera, glfwGetTime());
+
+				const glm::mat4& view = camera.GetViewMatrix(); // cached, only rebuilt after the camera moved
+				const glm::mat4& projection = camera.GetProjectionMatrix();
+
+				//Set Matrixes
+				glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
+				glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(view));
+				glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(projection));
+
+				// nearest cubes first (slot positions are close enough for the spinning ones, they only rotate in place)
+				if (sortFrontToBack)	{
+					std::sort(drawOrder.begin(), drawOrder.end(), [&](unsigned int a, unsigned int b) {
+						glm::vec3 toA = slotPositions[a] - camera.Position;
+						glm::vec3 toB = slotPositions[b] - camera.Position;
+						return glm::dot(toA, toA) < glm::dot(toB, toB);
+					});
+				}
+
+				// rasterize the occluders on the workers and drop every cube hidden behind them before anything is submitted
+				if (cpuOcclusionCulling)	{
+					cpuOcclusion.Clear();
+					cpuOcclusion.RenderOccluders(camera.GetViewProjectionMatrix(), occluderTriangles, &jobSystem);
+					cpuOcclusion.TestBoxes(camera.GetViewProjectionMatrix(), slotBoundsMin.data(), slotBoundsMax.data(), instanceCount, cubeVisible, &jobSystem);
+				}
+				cubesInView.clear();
+				cubeIndex.QueryFrustum(camera.GetFrustumPlanes(), cubesInView);
+				std::fill(cubeInView.begin(), cubeInView.end(), 0);
+				for (uint32_t slot : cubesInView)
+					cubeInView[slot] = 1;
+
+				visibleOrder.clear();
+				for (unsigned int slot : drawOrder)	{
+					if (cubeInView[slot] && (!cpuOcclusionCulling || cubeVisible[slot]))
+						visibleOrder.push_back(slot);
+				}
+			});
+
+		// the scene timing covers the prepass too, whichever pass draws first starts it
+		if (depthPrepass)	{
+			frameGraph.AddPass("depth prepass",
+				[&](FramePassBuilder& pass) {
+					pass.Write(sceneDepth);
+				},
+				[&](const FramePassContext&) {
+					dynamicResolution.BeginScene(screenWidth, screenHeight);
+					glActiveTexture(GL_TEXTURE2);
+					glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+
+					depthShader.use();
+					drawCubes(depthShader, false);
+					terrainDepthShader.use();
+					voxelRenderer.Draw(terrainDepthShader, camera);
+				});
 		}
 
+		// Render the scene offscreen at the current render scale
+		frameGraph.AddPass("scene",
+			[&](FramePassBuilder& pass) {
+				if (depthPrepass)
+					pass.Read(sceneDepth);
+				pass.Write(sceneColor);
+				pass.Write(sceneDepth);
+			},
+			[&](const FramePassContext&) {
+				if (!depthPrepass)
+					dynamicResolution.BeginScene(screenWidth, screenHeight);
+
+				// bind textures on corresponding texture units
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, texture1);
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_2D, texture2);
+				glActiveTexture(GL_TEXTURE2);
+				glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+
+				// after a prepass the depth buffer is final: only the front fragment of each pixel passes, and nothing needs writing
+				if (depthPrepass)	{
+					glDepthFunc(GL_EQUAL);
+					glDepthMask(GL_FALSE);
+				}
+
+				// GL allows one active occlusion query per target type, while culling its queries take precedence
+				if (!occlusionCulling)
+					shadedFragments.Begin();
+				if (showOverdraw)	{
+					glEnable(GL_BLEND);
+					glBlendFunc(GL_ONE, GL_ONE);
+					overdrawShader.use();
+					drawCubes(overdrawShader, occlusionCulling);
+					terrainOverdrawShader.use();
+					voxelRenderer.Draw(terrainOverdrawShader, camera);
+					glDisable(GL_BLEND);
+				}
+				else	{
+					// Draw the square
+					ourShader.use();
+
+					ourShader.setFloat("mixValue", mixValue);
+					ourShader.setMat4("transform", trans);
+					drawCubes(ourShader, occlusionCulling);
+
+					// the terrain takes texture1 from unit 0 too, tinted per block
+					terrainShader.use();
+					voxelRenderer.Draw(terrainShader, camera);
+				}
+				if (!occlusionCulling)
+					shadedFragments.End();
+
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+				dynamicResolution.EndScene();
+			});
+
+		// upscale to the window
+		frameGraph.AddPass("upscale",
+			[&](FramePassBuilder& pass) {
+				pass.Read(sceneColor);
+				pass.Write(backbuffer);
+			},
+			[&](const FramePassContext& context) {
+				dynamicResolution.Present(context.Framebuffer(sceneColor));
+			});
+
+		frameGraph.Execute();
 
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		framePacer.EndFrame();
+		renderTargetPool.EndFrame();
+		mouseLatch.OnSwap(glfwGetTime());
+
+#ifdef PRINT_FRAME_STATS
+		// once a second, print frame statistics
+		float currentFrame = static_cast<float>(glfwGetTime());
+		if (currentFrame - lastStatsReport >= 1.0f)	{
+			if (mouseLatch.LatchedFrames > 0)	{
+				std::cout << "input->latch " << 1000.0 * mouseLatch.TotalLatchLatency / mouseLatch.LatchedFrames << " ms, "
+					<< "input->swap " << 1000.0 * mouseLatch.TotalSwapLatency / mouseLatch.LatchedFrames << " ms (max " << 1000.0 * mouseLatch.MaxSwapLatency << " ms)" << std::endl;
+			}
+			std::cout << "frame " << 1000.0 * framePacer.MeanFrameTime << " ms (stddev " << 1000.0 * framePacer.FrameTimeStdDev()
+				<< " ms, min " << 1000.0 * framePacer.MinFrameTime << " ms, max " << 1000.0 * framePacer.MaxFrameTime << " ms)" << std::endl;
+			std::cout << "render scale " << dynamicResolution.Scale << " (" << dynamicResolution.RenderWidth() << "x" << dynamicResolution.RenderHeight()
+				<< "), scene GPU time " << 1000.0 * dynamicResolution.LastGpuTime() << " ms" << std::endl;
+			std::cout << "textures " << textureStreamer.ResidentBytes() / 1024 << " KB resident, " << textureStreamer.LevelsUploaded << " levels uploaded, "
+				<< textureStreamer.LevelsEvicted << " evicted, finest level " << textureStreamer.ResidentLevel(containerTexture) << " / " << textureStreamer.ResidentLevel(faceTexture)
+				<< ", " << textureCache.Hits << " cache hits, " << textureCache.Misses << " misses" << std::endl;
+			std::cout << "render targets " << renderTargetPool.TargetCount() << " (" << renderTargetPool.TransientBytes() / (1024 * 1024) << " MB, "
+				<< renderTargetPool.Allocations << " allocations so far)" << std::endl;
+			std::cout << "frame graph " << frameGraph.PassesExecuted << " passes (" << frameGraph.PassesCulled << " culled), "
+				<< frameGraph.TexturesAliased << " aliased textures, " << frameGraph.Invalidates << " invalidates" << std::endl;
+			std::cout << "shaded fragments " << shadedFragments.LastResult << " (" << (double)shadedFragments.LastResult / ((double)dynamicResolution.RenderWidth() * dynamicResolution.RenderHeight())
+				<< " per pixel, prepass " << (depthPrepass ? "on" : "off") << ", sorting " << (sortFrontToBack ? "on" : "off") << ")" << std::endl;
+			if (cpuOcclusionCulling)	{
+				std::cout << "CPU occlusion culling " << cpuOcclusion.BoxesVisible << " visible, " << cpuOcclusion.BoxesOccluded << " occluded, "
+					<< cpuOcclusion.BoxesViewCulled << " outside the view (" << cpuOcclusion.TrianglesRasterized << " occluder triangles)" << std::endl;
+			}
+			if (occlusionCulling)	{
+				std::cout << "occlusion culling " << occlusionCuller.DrawsIssued << " drawn, " << occlusionCuller.BoxesTested << " tested, "
+					<< occlusionCuller.FrustumCulled << " outside the frustum, " << occlusionCuller.DrawsSkipped << " conditional draws skipped this second" << std::endl;
+			}
+			std::cout << "terrain " << voxelRenderer.ChunksDrawn << " chunks drawn (" << voxelRenderer.ChunksCulled << " outside the view), "
+				<< voxelRenderer.QuadsDrawn << " quads (" << voxelRenderer.QuadsFacingAway << " facing away skipped), " << voxelRenderer.VertexBytes() / 1024 << " KB of " << (vertexPulling ? "face records, " : "packed vertices, ")
+				<< chunkManager.LoadedChunks() << " chunks loaded" << std::endl;
+			std::cout << "streaming " << chunkManager.LoadQueueDepth() << " to load, " << chunkManager.GeneratingDepth() << " generating, " << chunkManager.MeshingQueueDepth() << " meshing, "
+				<< chunkManager.UploadQueueDepth() << " to upload, last frame " << chunkManager.GenerateMs << " ms generating, "
+				<< chunkManager.BytesUploadedLastUpdate / 1024 << " KB uploaded in " << chunkManager.UploadMs << " ms" << std::endl;
+			const GpuBufferArena& meshBuffers = voxelRenderer.Buffers();
+			std::cout << "mesh buffers " << meshBuffers.ArenaCount() << " arenas, " << meshBuffers.UsedBytes() / 1024 << " of " << meshBuffers.CapacityBytes() / 1024
+				<< " KB used, " << meshBuffers.FreeBlockCount() << " free blocks (largest " << meshBuffers.LargestFreeBlock() / 1024 << " KB), fragmentation "
+				<< meshBuffers.Fragmentation() << ", " << meshBuffers.BytesMoved / 1024 << " KB moved by defragmentation, " << voxelRenderer.UploadsFailed << " uploads failed" << std::endl;
+			if (chunkManager.ChunksMadeVisible > 0)	{
+				std::cout << "time to visible " << 1000.0 * chunkManager.TotalTimeToVisible / chunkManager.ChunksMadeVisible << " ms (max "
+					<< 1000.0 * chunkManager.MaxTimeToVisible << " ms) over " << chunkManager.ChunksMadeVisible << " chunks" << std::endl;
+			}
+			mouseLatch.ResetStats();
+			chunkManager.ResetStats();
+			occlusionCuller.ResetStats();
+			framePacer.ResetStats();
+			lastStatsReport = currentFrame;
+		}
+#endif
 	}
 
+	simulation.Stop();
+
 	//De-allocate resources
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
-
-	// Exit cleanly
-	glfwTerminate();
+	glDeleteVertexArrays(1, &animationVAO);
+	glDeleteBuffers(1, &animationVBO);
+	glDeleteTextures(1, &instanceTexture);
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &matricesUBO);
+
+	// Exit cleanly: the streamer, renderer, pools and the rest release their GL objects as they go out of scope, then
+	// glfwSession terminates GLFW
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// Overdraw view: every shaded fragment adds this much with additive blending, so white means 8 or more layers
+const float OVERDRAW_STEP = 1.0 / 8.0;
+
+void main() {
+    FragColor = vec4(OVERDRAW_STEP, OVERDRAW_STEP, OVERDRAW_STEP, 1.0);
+}
\ No newline at end of file
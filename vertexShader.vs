@@ -6,12 +6,25 @@ layout(location = 1) in vec2 aTexCoord;
 out vec3 vertexColor;
 out vec2 TexCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// model matrices of every instance, 4 RGBA32F texels per matrix
+uniform samplerBuffer instanceMatrices;
+uniform int baseInstance;
+
+// camera matrices, written once per frame right after the late input latch
+layout(std140) uniform Matrices {
+    mat4 view;
+    mat4 projection;
+};
+
 uniform mat4 transform;
 
+// the depth prepass runs this same shader, the main pass then tests with GL_EQUAL and needs bit identical depths
+invariant gl_Position;
+
 void main() {
+    int texel = (baseInstance + gl_InstanceID) * 4;
+    mat4 model = mat4(texelFetch(instanceMatrices, texel), texelFetch(instanceMatrices, texel + 1), texelFetch(instanceMatrices, texel + 2), texelFetch(instanceMatrices, texel + 3));
+
     gl_Position = projection * view * model * (transform * vec4(aPos, 1.0));
     TexCoord = aTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 TexCoord;
+in float Shade;
+flat in int Layer;
+
+out vec4 FragColor;
+
+uniform sampler2D texture1;
+// tint per block type (Block_Type), indexed by the vertex's texture layer. Layer can hold ids past the array, which would
+// read out of bounds, so they are clamped to the last entry (VOXEL_SHADER_BLOCK_COLORS on the C++ side)
+const int BLOCK_COLOR_COUNT = 16;
+uniform vec3 blockColors[BLOCK_COLOR_COUNT];
+
+void main() {
+    FragColor = vec4(texture(texture1, TexCoord).rgb * blockColors[clamp(Layer, 0, BLOCK_COLOR_COUNT - 1)] * Shade, 1.0);
+}
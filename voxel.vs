@@ -0,0 +1,38 @@
+#version 330 core
+
+// one packed chunk mesh vertex, see PackVoxelVertex in ChunkMesher.h
+layout(location = 0) in uint aVertex;
+
+out vec2 TexCoord;
+out float Shade;
+flat out int Layer;
+
+// same layout as vertexShader.vs
+layout(std140) uniform Matrices {
+    mat4 view;
+    mat4 projection;
+};
+
+// world position of the chunk's minimum corner
+uniform vec3 chunkOrigin;
+
+// depth prepass, see vertexShader.vs
+invariant gl_Position;
+
+// +x/-x, +y/-y, +z/-z: tops brightest, bottoms darkest, so faces read apart without lighting
+const float faceShade[6] = float[6](0.8, 0.8, 1.0, 0.5, 0.65, 0.65);
+
+void main() {
+    vec3 local = vec3(uint(aVertex) & 63u, (aVertex >> 6) & 63u, (aVertex >> 12) & 63u);
+    int face = int((aVertex >> 18) & 7u);
+    int ao = int((aVertex >> 21) & 3u);
+    Layer = int(aVertex >> 23);
+
+    vec3 world = chunkOrigin + local;
+    gl_Position = projection * view * vec4(world, 1.0);
+
+    // one texture repeat per block, along the face's tangent axes
+    int d = face / 2;
+    TexCoord = d == 0 ? world.yz : (d == 1 ? world.zx : world.xy);
+    Shade = faceShade[face] * (0.4 + 0.2 * float(ao));
+}
@@ -0,0 +1,62 @@
+#version 330 core
+
+// Vertex pulling: no vertex attributes, every 6 vertices expand one face record (PackVoxelFace in ChunkMesher.h) into the two
+// triangles of its quad. Outputs match voxel.vs, so voxel.fs, depthOnly.fs and overdraw.fs work with either
+
+out vec2 TexCoord;
+out float Shade;
+flat out int Layer;
+
+// the chunk's face records, two uint32 per face
+uniform usamplerBuffer faces;
+
+// same layout as vertexShader.vs
+layout(std140) uniform Matrices {
+    mat4 view;
+    mat4 projection;
+};
+
+// world position of the chunk's minimum corner
+uniform vec3 chunkOrigin;
+
+// depth prepass, see vertexShader.vs
+invariant gl_Position;
+
+// same as voxel.vs
+const float faceShade[6] = float[6](0.8, 0.8, 1.0, 0.5, 0.65, 0.65);
+
+// VOXEL_QUAD_INDICES, and the corners in VoxelQuad order as steps along the face's tangents
+const int quadIndices[6] = int[6](0, 1, 2, 0, 2, 3);
+const vec2 cornerSteps[4] = vec2[4](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+int cornerOcclusion(uint ao, int corner) {
+    return int((ao >> uint(corner * 2)) & 3u);
+}
+
+void main() {
+    uvec2 record = texelFetch(faces, gl_VertexID / 6).rg;
+    vec3 local = vec3(record.x & 31u, (record.x >> 5) & 31u, (record.x >> 10) & 31u);
+    int face = int((record.x >> 15) & 7u);
+    vec2 size = vec2((record.x >> 18) & 31u, (record.x >> 23) & 31u) + 1.0;
+    uint ao = record.y >> 16;
+    Layer = int(record.y & 0xFFFFu);
+
+    // same winding and diagonal as ChunkMesh::AppendPackedVertices
+    int d = face / 2;
+    bool positive = (face & 1) == 0;
+    int start = cornerOcclusion(ao, 0) + cornerOcclusion(ao, 2) > cornerOcclusion(ao, 1) + cornerOcclusion(ao, 3) ? 1 : 0;
+    int i = quadIndices[gl_VertexID % 6];
+    int corner = positive ? (start + i) % 4 : (start + 4 - i) % 4;
+
+    if (positive)
+        local[d] += 1.0;
+    local[(d + 1) % 3] += cornerSteps[corner].x * size.x;
+    local[(d + 2) % 3] += cornerSteps[corner].y * size.y;
+
+    vec3 world = chunkOrigin + local;
+    gl_Position = projection * view * vec4(world, 1.0);
+
+    // one texture repeat per block, along the face's tangent axes
+    TexCoord = d == 0 ? world.yz : (d == 1 ? world.zx : world.xy);
+    Shade = faceShade[face] * (0.4 + 0.2 * float(cornerOcclusion(ao, corner)));
+}